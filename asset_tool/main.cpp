@@ -0,0 +1,190 @@
+#include <chrono>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "../software_gl/Image.h"
+#include "../software_gl/MappedFile.h"
+#include "../software_gl/Mesh.h"
+#include "../software_gl/MeshFile.h"
+#include "../software_gl/MeshStream.h"
+#include "../software_gl/TextureFile.h"
+
+namespace {
+
+	void PrintUsage()
+	{
+		std::cerr
+			<< "usage:" << std::endl
+			<< "  asset_tool texture <input.tga> <output.sglt>" << std::endl
+			<< "  asset_tool mesh <input.obj> <output.sglm>" << std::endl
+			<< "  asset_tool stream <input.obj> <output.sgls> [triangles]"
+			<< std::endl
+			<< "  asset_tool obj-bench <input.obj>" << std::endl;
+	}
+
+	// Decode a TGA and store it with all its mips.
+	int ConvertTexture(const std::string& input, const std::string& output)
+	{
+		SoftwareGL::Image image{};
+		if (!image.LoadFromTGA(input))
+		{
+			std::cerr << "Couldn't load " << input << "." << std::endl;
+			return -1;
+		}
+		if (!SoftwareGL::TextureFile::Write(image, output))
+		{
+			std::cerr << "Couldn't write " << output << "." << std::endl;
+			return -1;
+		}
+		SoftwareGL::TextureFile file;
+		if (!file.Open(output))
+		{
+			std::cerr << "Couldn't read back " << output << "." << std::endl;
+			return -1;
+		}
+		std::cout
+			<< output << ": "
+			<< image.GetSize().first << "x" << image.GetSize().second
+			<< ", " << file.GetLevelCount() << " levels." << std::endl;
+		return 0;
+	}
+
+	// Parse an OBJ, weld, reorder and cluster it, store it in its in-memory
+	// layout.
+	int ConvertMesh(const std::string& input, const std::string& output)
+	{
+		SoftwareGL::Mesh mesh{};
+		if (!mesh.LoadFromObj(input))
+		{
+			std::cerr << "Couldn't load " << input << "." << std::endl;
+			return -1;
+		}
+		mesh.ComputeFlat();
+		mesh.Optimize();
+		mesh.BuildClusters();
+		if (!SoftwareGL::MeshFile::Write(mesh, output, {}))
+		{
+			std::cerr << "Couldn't write " << output << "." << std::endl;
+			return -1;
+		}
+		std::cout
+			<< output << ": "
+			<< mesh.GetIndices().size() / 3 << " triangles, "
+			<< mesh.GetFlatPositions().size() / 3 << " vertices, "
+			<< mesh.GetClusters().size() << " clusters."
+			<< std::endl;
+		return 0;
+	}
+
+	// Cut an OBJ into chunks that can be streamed from disk.
+	int ConvertStream(
+		const std::string& input,
+		const std::string& output,
+		const size_t triangles_per_chunk)
+	{
+		SoftwareGL::Mesh mesh{};
+		if (!mesh.LoadFromObj(input))
+		{
+			std::cerr << "Couldn't load " << input << "." << std::endl;
+			return -1;
+		}
+		// Keep the cache friendly order inside the chunks.
+		mesh.Optimize();
+		if (!SoftwareGL::MeshStream::Write(mesh, output, triangles_per_chunk))
+		{
+			std::cerr << "Couldn't write " << output << "." << std::endl;
+			return -1;
+		}
+		SoftwareGL::MeshStream stream(std::numeric_limits<size_t>::max());
+		if (!stream.Open(output))
+		{
+			std::cerr << "Couldn't read back " << output << "." << std::endl;
+			return -1;
+		}
+		std::cout
+			<< output << ": "
+			<< stream.GetTriangleCount() << " triangles in "
+			<< stream.GetChunkCount() << " chunks of at most "
+			<< stream.GetMaxChunkSize() << " bytes." << std::endl;
+		return 0;
+	}
+
+	// Load an OBJ with a loader and print its throughput.
+	template <typename Load>
+	bool TimeObjLoad(
+		const std::string& name,
+		const std::string& input,
+		const size_t file_size,
+		Load load)
+	{
+		SoftwareGL::Mesh mesh{};
+		const auto start = std::chrono::steady_clock::now();
+		if (!load(mesh, input))
+		{
+			std::cerr
+				<< name << ": couldn't load " << input << "." << std::endl;
+			return false;
+		}
+		const std::chrono::duration<double> elapsed =
+			std::chrono::steady_clock::now() - start;
+		const double megabytes = file_size / (1024.0 * 1024.0);
+		std::cout
+			<< name << ": "
+			<< mesh.GetIndices().size() / 3 << " triangles in "
+			<< elapsed.count() * 1000.0 << " ms, "
+			<< megabytes / elapsed.count() << " MB/s." << std::endl;
+		return true;
+	}
+
+	// Compare the mapped parser with the stream one.
+	int BenchObj(const std::string& input)
+	{
+		SoftwareGL::MappedFile file;
+		if (!file.Open(input))
+		{
+			std::cerr << "Couldn't open " << input << "." << std::endl;
+			return -1;
+		}
+		const size_t file_size = file.GetSize();
+		file.Close();
+		const bool stream_ok = TimeObjLoad("stream", input, file_size,
+			[](SoftwareGL::Mesh& mesh, const std::string& path)
+		{
+			return mesh.LoadFromObjStream(path);
+		});
+		const bool mapped_ok = TimeObjLoad("mapped", input, file_size,
+			[](SoftwareGL::Mesh& mesh, const std::string& path)
+		{
+			return mesh.LoadFromObj(path);
+		});
+		return (stream_ok && mapped_ok) ? 0 : -1;
+	}
+
+}	// End anonymous namespace.
+
+int main(int ac, char** av)
+{
+	const std::vector<std::string> args(av + 1, av + ac);
+	if (args.size() == 3 && args[0] == "texture")
+	{
+		return ConvertTexture(args[1], args[2]);
+	}
+	if (args.size() == 3 && args[0] == "mesh")
+	{
+		return ConvertMesh(args[1], args[2]);
+	}
+	if ((args.size() == 3 || args.size() == 4) && args[0] == "stream")
+	{
+		const size_t triangles_per_chunk =
+			(args.size() == 4) ? std::stoul(args[3]) : 64 * 1024;
+		return ConvertStream(args[1], args[2], triangles_per_chunk);
+	}
+	if (args.size() == 2 && args[0] == "obj-bench")
+	{
+		return BenchObj(args[1]);
+	}
+	PrintUsage();
+	return -1;
+}
@@ -1,14 +1,18 @@
 #include "Texture.h"
 #include <assert.h>
 #include <GL/glew.h>
-#include "../software_gl/Image.h"
+#include "../software_gl/AssetCache.h"
 
 namespace OpenGL {
 
-	Texture::Texture(const std::string& file)
+	Texture::Texture(const std::string& file) :
+		Texture(SoftwareGL::AssetCache::GetInstance().LoadTextureFromTGA(file))
+	{}
+
+	Texture::Texture(std::shared_ptr<const SoftwareGL::Image> image)
 	{
-		SoftwareGL::Image img{};
-		img.LoadFromTGA(file);
+		assert(image);
+		const SoftwareGL::Image& img = *image;
 		size_ = img.GetSize();
 		assert(img.size() % size_.first == 0);
 		glGenTextures(1, &texture_id_);
@@ -30,6 +34,40 @@ namespace OpenGL {
 		glGenerateMipmap(GL_TEXTURE_2D);
 	}
 
+	Texture::Texture(std::shared_ptr<const SoftwareGL::TextureFile> file)
+	{
+		assert(file && file->GetLevelCount());
+		size_ = file->GetLevel(0).GetSize();
+		glGenTextures(1, &texture_id_);
+		glBindTexture(GL_TEXTURE_2D, texture_id_);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTexParameteri(
+			GL_TEXTURE_2D,
+			GL_TEXTURE_MIN_FILTER,
+			GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(
+			GL_TEXTURE_2D,
+			GL_TEXTURE_MAX_LEVEL,
+			static_cast<GLint>(file->GetLevelCount() - 1));
+		// Upload the precomputed mips straight from the mapped file.
+		for (size_t i = 0; i < file->GetLevelCount(); ++i)
+		{
+			const SoftwareGL::ImageView& level = file->GetLevel(i);
+			glTexImage2D(
+				GL_TEXTURE_2D,
+				static_cast<GLint>(i),
+				GL_RGBA8,
+				static_cast<GLsizei>(level.GetSize().first),
+				static_cast<GLsizei>(level.GetSize().second),
+				0,
+				GL_RGBA,
+				GL_FLOAT,
+				level.data());
+		}
+	}
+
 	Texture::~Texture() 
 	{
 		glDeleteTextures(1, &texture_id_);
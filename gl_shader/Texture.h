@@ -1,15 +1,22 @@
 #pragma once
 
+#include <memory>
 #include <string>
 #include <vector>
 #include <utility>
 #include "../software_gl/VectorMath.h"
+#include "../software_gl/Image.h"
+#include "../software_gl/TextureFile.h"
 
 namespace OpenGL {
 
 	class Texture {
 	public:
+		// Load the file through the shared asset cache.
 		Texture(const std::string& file);
+		Texture(std::shared_ptr<const SoftwareGL::Image> image);
+		// Use the mips stored in the file instead of generating them.
+		Texture(std::shared_ptr<const SoftwareGL::TextureFile> file);
 		virtual ~Texture();
 		void Bind(const unsigned int slot = 0) const;
 		void UnBind() const;
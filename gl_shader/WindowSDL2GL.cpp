@@ -24,6 +24,7 @@
 #include "Shader.h"
 #include "WindowSDL2GL.h"
 #include "Texture.h"
+#include "../software_gl/AssetCache.h"
 
 namespace SoftwareGL {
 
@@ -204,10 +205,23 @@ namespace SoftwareGL {
 		glEnable(GL_DEBUG_OUTPUT);
 		glDebugMessageCallback(WindowSDL2GL::ErrorMessageHandler, nullptr);
 #endif
-		// Mesh creation.
-		mesh_ = std::make_shared<SoftwareGL::Mesh>();
-		mesh_->LoadFromObj("../asset/TorusUVNormal.obj");
-		mesh_->ComputeFlat();
+		// Mesh creation, the buffers are uploaded straight from the mapped
+		// sidecar of the OBJ.
+		mesh_ = SoftwareGL::AssetCache::GetInstance().LoadMeshFile(
+			"../asset/TorusUVNormal.obj");
+		if (!mesh_)
+		{
+#if defined(_WIN32) || defined(_WIN64)
+			MessageBox(
+				hwnd_,
+				"Couldn't load the mesh.",
+				"Shader GL Error",
+				0);
+#else
+			std::cerr << "Couldn't load the mesh." << std::endl;
+#endif
+			return false;
+		}
 
 		// Position buffer initialization.
 		GLuint point_buffer_object = 0;
@@ -310,9 +324,20 @@ namespace SoftwareGL {
 		
 		// Bind the texture to the shader.
 		const unsigned int slot = 0;
-		texture1_ = std::make_shared<OpenGL::Texture>(
-			"../asset/Texture.tga");
-//			"../asset/PaintedMetal05_col.tga");
+		// Prefer the precomputed mips (see asset_tool) over the TGA.
+		auto texture_file =
+			SoftwareGL::AssetCache::GetInstance().LoadTextureFile(
+				"../asset/Texture.sglt");
+		if (texture_file)
+		{
+			texture1_ = std::make_shared<OpenGL::Texture>(texture_file);
+		}
+		else
+		{
+			texture1_ = std::make_shared<OpenGL::Texture>(
+				"../asset/Texture.tga");
+//				"../asset/PaintedMetal05_col.tga");
+		}
 		texture1_->Bind(slot);
 		program_->UniformInt("texture1", slot);
 		
@@ -3,7 +3,7 @@
 #include <memory>
 #include <utility>
 #include <SDL.h>
-#include "../software_gl/Mesh.h"
+#include "../software_gl/MeshFile.h"
 #include "../software_gl/Camera.h"
 #include "Program.h"
 #include "Texture.h"
@@ -41,7 +41,7 @@ namespace SoftwareGL {
 		std::shared_ptr<WindowInterface> window_interface_;
 		std::shared_ptr<OpenGL::Program> program_ = nullptr;
 		std::shared_ptr<OpenGL::Texture> texture1_ = nullptr;
-		std::shared_ptr<SoftwareGL::Mesh> mesh_ = nullptr;
+		std::shared_ptr<const SoftwareGL::MeshFile> mesh_ = nullptr;
 		std::shared_ptr<SoftwareGL::Camera> camera_ = nullptr;
 		VectorMath::matrix model_ = {};
 		SDL_Window* sdl_window_ = nullptr;
@@ -1,4 +1,5 @@
 #include "WindowSoftwareGL.h"
+#include "../software_gl/AssetCache.h"
 
 #include <GL/glew.h>
 #include <SDL.h>
@@ -18,18 +19,60 @@ bool WindowSoftwareGL::Startup(const std::pair<int, int>& gl_version)
 		1000.0f);
 	look_at_ = cam_.LookAt();
 	look_at_.Inverse();
-	// if (!mesh_.LoadFromObj(R"(../asset/CubeUVNormal.obj)")) assert(false);
-	if (!mesh_.LoadFromObj(R"(../asset/TorusUVNormal.obj)")) assert(false);
-	SoftwareGL::Image texture{};
-	if (!texture.LoadFromTGA(R"(../asset/Texture.tga)")) assert(false);
-	renderer_.SetTexture(texture);
+	// The torus is closed, its back faces (and the clusters facing away)
+	// are never seen.
+	SoftwareGL::PipelineState state = renderer_.GetPipelineState();
+	state.cull = SoftwareGL::CullMode::BACK;
+	renderer_.SetPipelineState(state);
+	auto& cache = SoftwareGL::AssetCache::GetInstance();
+	// Stream the mesh from disk if it was converted (see asset_tool).
+	mesh_stream_ = std::make_unique<SoftwareGL::MeshStream>();
+	if (!mesh_stream_->Open(R"(../asset/TorusUVNormal.sgls)"))
+	{
+		mesh_stream_ = nullptr;
+		// mesh_ = cache.LoadMeshFromObj(R"(../asset/CubeUVNormal.obj)");
+		mesh_ = cache.LoadMeshFromObj(R"(../asset/TorusUVNormal.obj)");
+		if (!mesh_) assert(false);
+		lod_ = SoftwareGL::MeshLod(mesh_);
+		// Rows of copies behind the mesh, centered on the view.
+		const float field_center = static_cast<float>(field_size_) * .5f;
+		for (size_t z = 0; z < field_size_; ++z)
+		{
+			for (size_t x = 0; x < field_size_; ++x)
+			{
+				SoftwareGL::Instance instance = {};
+				instance.model.TranslateMatrix(
+					(static_cast<float>(x) - field_center) * 3.f,
+					-3.f,
+					6.f + static_cast<float>(z) * 3.f);
+				field_.push_back(instance);
+			}
+		}
+		if (compact_vertices_)
+		{
+			for (size_t i = 0; i < lod_.GetLevelCount(); ++i)
+			{
+				compact_levels_.emplace_back(*lod_.GetLevel(i).mesh);
+			}
+		}
+	}
+	// Prefer the precomputed mips (see asset_tool) over the TGA.
+	auto texture_file = cache.LoadTextureFile(R"(../asset/Texture.sglt)");
+	if (texture_file)
+	{
+		renderer_.SetTexture(texture_file);
+	}
+	else
+	{
+		auto texture = cache.LoadTextureFromTGA(R"(../asset/Texture.tga)");
+		if (!texture) assert(false);
+		renderer_.SetTexture(texture);
+	}
 	return true;
 }
 
 bool WindowSoftwareGL::RunCompute()
 {
-	// Cleanup of buffers.
-	renderer_.ClearFrame({ .2f, 0.f, .2f, 1.f }, z_max_);
 	// Timing counter.
 	static auto start = std::chrono::system_clock::now();
 	auto end = std::chrono::system_clock::now();
@@ -44,27 +87,62 @@ bool WindowSoftwareGL::RunCompute()
 		r_z.RotateZMatrix(time.count());
 		rotation = r_x * r_y * r_z;
 	}
-	// Make a copy of mesh to make the view transformations.
-	SoftwareGL::Mesh mesh = mesh_;
-	mesh.AllPositionMatrixMult(rotation);
-	mesh.AllNormalMatrixMult(rotation);
-	mesh.AllPositionMatrixMult(look_at_);
-	mesh.AllPositionMatrixMult(projection_);
-	// mesh.AllTextureDivideByZ();
-	mesh.AllPositionDivideByW();
-	mesh.AllPositionAdd(1.0f);
-	mesh.AllPositionMult(0.5f);
-	mesh.AllPositionMult(
-		VectorMath::vector(
-			static_cast<float>(width_),
-			static_cast<float>(height_),
-			1,
-			1));
-	// Compute for every triangle.
-	for (const SoftwareGL::Triangle& triangle_in : mesh)
+	const VectorMath::vector clear_color = { .2f, 0.f, .2f, 1.f };
+	if (mesh_stream_)
+	{
+		// Chunks are dropped after drawing, so they are drawn right away
+		// one at a time instead of being recorded.
+		renderer_.ClearFrame(clear_color, z_max_);
+		return mesh_stream_->ForEachChunk([this, &rotation](
+			SoftwareGL::Mesh& chunk)
+		{
+			renderer_.Submit({ &chunk, rotation });
+			renderer_.DrawScene(look_at_, projection_);
+		});
+	}
+	// Level for the size on screen, read as it is by the vertex stage.
+	const size_t level =
+		renderer_.SelectLod(lod_, rotation * look_at_, projection_);
+	if (lambert_shading_)
+	{
+		// Shaders are types, they can't be recorded: drawn right away.
+		SoftwareGL::DrawItem item = {};
+		item.model = rotation;
+		if (compact_vertices_)
+		{
+			item.compact_mesh = &compact_levels_[level];
+		}
+		else
+		{
+			item.mesh = lod_.GetLevel(level).mesh.get();
+		}
+		renderer_.ClearFrame(clear_color, z_max_);
+		renderer_.Submit(item);
+		renderer_.DrawScene(
+			look_at_,
+			projection_,
+			SoftwareGL::LambertVertexShader(),
+			SoftwareGL::LambertFragmentShader(),
+			vertex_cache_);
+		return true;
+	}
+	// Record the frame, the buffer keeps its capacity.
+	commands_.Reset();
+	commands_.Clear(clear_color, z_max_);
+	commands_.SetCamera(look_at_, projection_);
+	if (compact_vertices_)
+	{
+		commands_.Draw(compact_levels_[level], rotation);
+	}
+	else
 	{
-		renderer_.DrawTriangle(triangle_in);
+		commands_.Draw(*lod_.GetLevel(level).mesh, rotation);
 	}
+	if (!field_.empty()) commands_.DrawInstanced(*mesh_, field_);
+	// Drawn by the worker of the queue, the image is shown once it is
+	// done.
+	queue_.Submit(commands_);
+	queue_.Finish();
 	return true;
 }
 
@@ -1,10 +1,16 @@
 #pragma once
 
 #include "WindowInterface.h"
+#include <memory>
 #include "../software_gl/VectorMath.h"
 #include "../software_gl/Image.h"
 #include "../software_gl/Camera.h"
+#include "../software_gl/CommandBuffer.h"
+#include "../software_gl/CommandQueue.h"
 #include "../software_gl/Mesh.h"
+#include "../software_gl/MeshLod.h"
+#include "../software_gl/MeshStream.h"
+#include "../software_gl/QuantizedMesh.h"
 #include "../software_gl/Renderer.h"
 
 class WindowSoftwareGL : public SoftwareGL::WindowInterface
@@ -14,7 +20,8 @@ public:
 		cam_({ 0, 0, -4 }, { 0, 0, -1 }, { 0, 1, 0 }),
 		width_(width), 
 		height_(height), 
-		renderer_(SoftwareGL::Image(width, height)) {}
+		renderer_(SoftwareGL::Image(width, height)),
+		queue_(renderer_) {}
 	bool Startup(const std::pair<int, int>& gl_version) override;
 	bool RunCompute() override;
 	bool RunEvent(const SDL_Event& event) override;
@@ -28,9 +35,29 @@ public:
 protected:
 	VectorMath::matrix projection_;
 	VectorMath::matrix look_at_;
-	SoftwareGL::Mesh mesh_;
+	std::shared_ptr<const SoftwareGL::Mesh> mesh_ = nullptr;
+	// Simplified versions of mesh_, picked by their size on screen.
+	SoftwareGL::MeshLod lod_ = {};
+	// Keep the levels in the compact format and decode them every frame.
+	bool compact_vertices_ = true;
+	std::vector<SoftwareGL::QuantizedMesh> compact_levels_ = {};
+	// Used instead of mesh_ when a streamed version exists.
+	std::unique_ptr<SoftwareGL::MeshStream> mesh_stream_ = nullptr;
 	SoftwareGL::Camera cam_;
+	// Copies of mesh_ drawn instanced on a field_size_ x field_size_
+	// grid, none by default.
+	size_t field_size_ = 0;
+	std::vector<SoftwareGL::Instance> field_ = {};
+	// Shade the mesh with the Lambert shaders (see Shader.h) instead of
+	// the texture.
+	bool lambert_shading_ = false;
+	SoftwareGL::VertexCache<SoftwareGL::LambertVertexShader::Varyings>
+		vertex_cache_;
+	// Frame recorded by RunCompute, executed by the queue.
+	SoftwareGL::CommandBuffer commands_ = {};
 	SoftwareGL::Renderer renderer_;
+	// Declared after the renderer it draws with.
+	SoftwareGL::CommandQueue queue_;
 	size_t width_ = 640;
 	size_t height_ = 480;
 	float z_min_ = 0.1f;
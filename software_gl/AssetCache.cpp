@@ -0,0 +1,238 @@
+#include "AssetCache.h"
+
+#include <algorithm>
+#include "MappedFile.h"
+
+namespace SoftwareGL {
+
+	namespace {
+
+		// FNV-1a over the whole file content.
+		std::uint64_t HashContent(const std::uint8_t* data, const size_t size)
+		{
+			std::uint64_t hash = 14695981039346656037ull;
+			for (size_t i = 0; i < size; ++i)
+			{
+				hash ^= data[i];
+				hash *= 1099511628211ull;
+			}
+			return hash ^ size;
+		}
+
+		// Open the sidecar of an OBJ if it was built from this version of
+		// the OBJ (and holds the flat buffers when they are needed).
+		bool OpenSidecar(
+			const std::string& path,
+			const MeshFile::Source& source,
+			const bool compute_flat,
+			MeshFile& sidecar)
+		{
+			if (!sidecar.Open(path + MeshFile::extension)) return false;
+			if (sidecar.GetSource().size != source.size) return false;
+			if (sidecar.GetSource().time != source.time) return false;
+			return !compute_flat || sidecar.HasFlat();
+		}
+
+		std::shared_ptr<Mesh> ParseObj(
+			const MappedFile& file,
+			const bool compute_flat)
+		{
+			auto mesh = std::make_shared<Mesh>();
+			if (!mesh->LoadFromObj(
+				reinterpret_cast<const char*>(file.GetData()),
+				file.GetSize()))
+			{
+				return nullptr;
+			}
+			if (compute_flat) mesh->ComputeFlat();
+			mesh->Optimize();
+			mesh->BuildClusters();
+			return mesh;
+		}
+
+		template <typename T, typename Map>
+		std::shared_ptr<const T> Find(
+			const Map& map,
+			const typename Map::key_type& key)
+		{
+			auto it = map.find(key);
+			if (it == map.end()) return nullptr;
+			return it->second.lock();
+		}
+
+		template <typename Map>
+		void PurgeMap(Map& map)
+		{
+			for (auto it = map.begin(); it != map.end();)
+			{
+				if (it->second.expired())
+				{
+					it = map.erase(it);
+				}
+				else
+				{
+					++it;
+				}
+			}
+		}
+
+		template <typename Map>
+		size_t CountAlive(const Map& map)
+		{
+			return std::count_if(map.begin(), map.end(), [](const auto& p)
+			{
+				return !p.second.expired();
+			});
+		}
+
+	}	// End anonymous namespace.
+
+	AssetCache& AssetCache::GetInstance()
+	{
+		static AssetCache cache;
+		return cache;
+	}
+
+	std::shared_ptr<const Image> AssetCache::LoadTextureFromTGA(
+		const std::string& path)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (auto image = Find<Image>(textures_by_path_, path)) return image;
+		MappedFile file;
+		if (!file.Open(path)) return nullptr;
+		const std::uint64_t hash = HashContent(file.GetData(), file.GetSize());
+		auto image = Find<Image>(textures_by_hash_, hash);
+		if (!image)
+		{
+			auto loaded = std::make_shared<Image>();
+			if (!loaded->LoadFromTGA(file.GetData(), file.GetSize()))
+			{
+				return nullptr;
+			}
+			image = loaded;
+			textures_by_hash_[hash] = image;
+		}
+		textures_by_path_[path] = image;
+		return image;
+	}
+
+	std::shared_ptr<const TextureFile> AssetCache::LoadTextureFile(
+		const std::string& path)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (auto texture = Find<TextureFile>(texture_files_by_path_, path))
+		{
+			return texture;
+		}
+		auto texture = std::make_shared<TextureFile>();
+		if (!texture->Open(path)) return nullptr;
+		texture_files_by_path_[path] = texture;
+		return texture;
+	}
+
+	std::shared_ptr<const Mesh> AssetCache::LoadMeshFromObj(
+		const std::string& path,
+		const bool compute_flat /*= false*/)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		// Flat and non flat meshes are different assets.
+		const std::string key = compute_flat ? path + "#flat" : path;
+		if (auto mesh = Find<Mesh>(meshes_by_path_, key)) return mesh;
+		MeshFile::Source source;
+		if (!MeshFile::StatSource(path, source)) return nullptr;
+		MeshFile sidecar;
+		std::shared_ptr<Mesh> loaded = nullptr;
+		if (OpenSidecar(path, source, compute_flat, sidecar))
+		{
+			source.hash = sidecar.GetSource().hash;
+		}
+		else
+		{
+			MappedFile file;
+			if (!file.Open(path)) return nullptr;
+			source.hash = HashContent(file.GetData(), file.GetSize());
+			loaded = ParseObj(file, compute_flat);
+			if (!loaded) return nullptr;
+			// The sidecar is only a cache, not being able to write it
+			// isn't an error.
+			MeshFile::Write(*loaded, path + MeshFile::extension, source);
+		}
+		// A content hash can be loaded with and without the flat buffers.
+		HashMap<Mesh>& meshes_by_hash =
+			compute_flat ? flat_meshes_by_hash_ : meshes_by_hash_;
+		auto mesh = Find<Mesh>(meshes_by_hash, source.hash);
+		if (!mesh)
+		{
+			if (!loaded)
+			{
+				loaded = std::make_shared<Mesh>();
+				if (!loaded->LoadFromMeshFile(sidecar, compute_flat))
+				{
+					return nullptr;
+				}
+			}
+			mesh = loaded;
+			meshes_by_hash[source.hash] = mesh;
+		}
+		meshes_by_path_[key] = mesh;
+		return mesh;
+	}
+
+	std::shared_ptr<const MeshFile> AssetCache::LoadMeshFile(
+		const std::string& path)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (auto file = Find<MeshFile>(mesh_files_by_path_, path))
+		{
+			return file;
+		}
+		MeshFile::Source source;
+		if (!MeshFile::StatSource(path, source)) return nullptr;
+		auto file = std::make_shared<MeshFile>();
+		if (!OpenSidecar(path, source, true, *file))
+		{
+			MappedFile obj;
+			if (!obj.Open(path)) return nullptr;
+			source.hash = HashContent(obj.GetData(), obj.GetSize());
+			auto mesh = ParseObj(obj, true);
+			if (!mesh) return nullptr;
+			if (!MeshFile::Write(*mesh, path + MeshFile::extension, source))
+			{
+				return nullptr;
+			}
+			if (!OpenSidecar(path, source, true, *file)) return nullptr;
+		}
+		mesh_files_by_path_[path] = file;
+		return file;
+	}
+
+	void AssetCache::Purge()
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		PurgeMap(textures_by_path_);
+		PurgeMap(textures_by_hash_);
+		PurgeMap(texture_files_by_path_);
+		PurgeMap(meshes_by_path_);
+		PurgeMap(meshes_by_hash_);
+		PurgeMap(flat_meshes_by_hash_);
+		PurgeMap(mesh_files_by_path_);
+	}
+
+	size_t AssetCache::GetTextureCount() const
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		return
+			CountAlive(textures_by_hash_) +
+			CountAlive(texture_files_by_path_);
+	}
+
+	size_t AssetCache::GetMeshCount() const
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		return
+			CountAlive(meshes_by_hash_) +
+			CountAlive(flat_meshes_by_hash_) +
+			CountAlive(mesh_files_by_path_);
+	}
+
+}	// End namespace SoftwareGL.
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "Image.h"
+#include "Mesh.h"
+#include "MeshFile.h"
+#include "TextureFile.h"
+
+namespace SoftwareGL {
+
+	// Process wide cache of immutable assets. Assets are looked up by path
+	// first and then by a hash of the file content, so the same file (or a
+	// copy of it under another name) is only decoded and held once (mapped
+	// texture files are only looked up by path as hashing them would page
+	// them in). The cache keeps weak references, an asset is released as
+	// soon as the last handle to it goes away. Parsed OBJ files are saved
+	// next to the source as a binary sidecar (.obj.sglm) that is used
+	// instead of the OBJ as long as the OBJ size and time don't change.
+	class AssetCache
+	{
+	public:
+		static AssetCache& GetInstance();
+
+	public:
+		// Return nullptr if the file could not be loaded.
+		std::shared_ptr<const Image> LoadTextureFromTGA(
+			const std::string& path);
+		// Precomputed mip chain (.sglt), mapped and shared.
+		std::shared_ptr<const TextureFile> LoadTextureFile(
+			const std::string& path);
+		// With compute_flat the mesh also holds the OpenGL (flat) buffers.
+		std::shared_ptr<const Mesh> LoadMeshFromObj(
+			const std::string& path,
+			const bool compute_flat = false);
+		// Mapped sidecar of an OBJ (with the flat buffers), the arrays are
+		// used in place. Return nullptr if the sidecar couldn't be written.
+		std::shared_ptr<const MeshFile> LoadMeshFile(const std::string& path);
+		// Forget about all the expired entries.
+		void Purge();
+		size_t GetTextureCount() const;
+		size_t GetMeshCount() const;
+
+	protected:
+		AssetCache() = default;
+		template <typename T>
+		using WeakMap =
+			std::unordered_map<std::string, std::weak_ptr<const T>>;
+		template <typename T>
+		using HashMap =
+			std::unordered_map<std::uint64_t, std::weak_ptr<const T>>;
+
+	private:
+		mutable std::mutex mutex_;
+		WeakMap<Image> textures_by_path_ = {};
+		HashMap<Image> textures_by_hash_ = {};
+		WeakMap<TextureFile> texture_files_by_path_ = {};
+		WeakMap<Mesh> meshes_by_path_ = {};
+		HashMap<Mesh> meshes_by_hash_ = {};
+		// Meshes loaded with their flat buffers.
+		HashMap<Mesh> flat_meshes_by_hash_ = {};
+		WeakMap<MeshFile> mesh_files_by_path_ = {};
+	};
+
+}	// End namespace SoftwareGL.
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace SoftwareGL {
+
+	// Non owning view on a contiguous array, used to hand out data that is
+	// stored elsewhere (a std::vector or a mapped file) without copying it.
+	template <typename T>
+	class BufferView
+	{
+	public:
+		BufferView() = default;
+		BufferView(const T* data, std::size_t size) :
+			data_(data), size_(size) {}
+		BufferView(const std::vector<T>& vec) :
+			data_(vec.data()), size_(vec.size()) {}
+
+	public:
+		const T& operator[](std::size_t index) const { return data_[index]; }
+		const T* data() const { return data_; }
+		std::size_t size() const { return size_; }
+		bool empty() const { return size_ == 0; }
+		const T* begin() const { return data_; }
+		const T* end() const { return data_ + size_; }
+
+	private:
+		const T* data_ = nullptr;
+		std::size_t size_ = 0;
+	};
+
+}	// End namespace SoftwareGL.
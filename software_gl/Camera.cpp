@@ -37,4 +37,13 @@ namespace SoftwareGL {
 		return { pos_.x, pos_.y, pos_.z, 0 };
 	}
 
+	const Frustum Camera::ViewFrustum(
+		const VectorMath::matrix& projection) const
+	{
+		// LookAt goes from the camera to the world.
+		VectorMath::matrix view = LookAt();
+		view.Inverse();
+		return Frustum(view * projection);
+	}
+
 }	// End namespace SoftwareGL.
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "Frustum.h"
 #include "VectorMath.h"
 
 namespace SoftwareGL {
@@ -14,6 +15,8 @@ namespace SoftwareGL {
 		const VectorMath::matrix LookAt() const;
 		const VectorMath::vector Direction() const;
 		const VectorMath::vector Position() const;
+		// Planes of what the camera sees through projection, in world space.
+		const Frustum ViewFrustum(const VectorMath::matrix& projection) const;
 
 	protected:
 		VectorMath::vector3 pos_ = { 0, 0, 0 };
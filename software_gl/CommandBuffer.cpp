@@ -0,0 +1,142 @@
+#include "CommandBuffer.h"
+
+#include <assert.h>
+
+namespace SoftwareGL {
+
+	void CommandBuffer::Reset()
+	{
+		commands_.clear();
+		colors_.clear();
+		matrices_.clear();
+		instances_.clear();
+	}
+
+	void CommandBuffer::Clear(
+		const VectorMath::vector& color,
+		const float z_max)
+	{
+		Command command = {};
+		command.type = CommandType::CLEAR;
+		command.z_max = z_max;
+		command.first = colors_.size();
+		colors_.push_back(color);
+		commands_.push_back(command);
+	}
+
+	void CommandBuffer::SetTexture(
+		const TextureUnit& unit,
+		const unsigned int slot /*= 0*/)
+	{
+		assert(slot < Renderer::max_texture_units);
+		Command command = {};
+		command.type = CommandType::SET_TEXTURE;
+		command.slot = slot;
+		command.texture = &unit;
+		commands_.push_back(command);
+	}
+
+	void CommandBuffer::SetCamera(
+		const VectorMath::matrix& view,
+		const VectorMath::matrix& projection)
+	{
+		Command command = {};
+		command.type = CommandType::SET_CAMERA;
+		command.first = matrices_.size();
+		matrices_.push_back(view);
+		matrices_.push_back(projection);
+		commands_.push_back(command);
+	}
+
+	void CommandBuffer::Draw(
+		const Mesh& mesh,
+		const VectorMath::matrix& model,
+		const TextureUnit* texture /*= nullptr*/)
+	{
+		Command command = {};
+		command.type = CommandType::DRAW;
+		command.first = matrices_.size();
+		command.mesh = &mesh;
+		command.texture = texture;
+		matrices_.push_back(model);
+		commands_.push_back(command);
+	}
+
+	void CommandBuffer::Draw(
+		const QuantizedMesh& mesh,
+		const VectorMath::matrix& model,
+		const TextureUnit* texture /*= nullptr*/)
+	{
+		Command command = {};
+		command.type = CommandType::DRAW;
+		command.first = matrices_.size();
+		command.compact_mesh = &mesh;
+		command.texture = texture;
+		matrices_.push_back(model);
+		commands_.push_back(command);
+	}
+
+	void CommandBuffer::DrawInstanced(
+		const Mesh& mesh,
+		const BufferView<Instance>& instances)
+	{
+		Command command = {};
+		command.type = CommandType::DRAW_INSTANCED;
+		command.first = instances_.size();
+		command.count = instances.size();
+		command.mesh = &mesh;
+		instances_.insert(instances_.end(), instances.begin(), instances.end());
+		commands_.push_back(command);
+	}
+
+	void CommandBuffer::Execute(Renderer& renderer) const
+	{
+		VectorMath::matrix view;
+		VectorMath::matrix projection;
+		// Draws wait in the draw list of the renderer until something else
+		// comes.
+		bool has_draws = false;
+		const auto flush = [&]
+		{
+			if (!has_draws) return;
+			renderer.DrawScene(view, projection);
+			has_draws = false;
+		};
+		for (const Command& command : commands_)
+		{
+			if (command.type != CommandType::DRAW) flush();
+			switch (command.type)
+			{
+			case CommandType::CLEAR:
+				renderer.ClearFrame(colors_[command.first], command.z_max);
+				break;
+			case CommandType::SET_TEXTURE:
+				renderer.SetTextureUnit(*command.texture, command.slot);
+				break;
+			case CommandType::SET_CAMERA:
+				view = matrices_[command.first];
+				projection = matrices_[command.first + 1];
+				break;
+			case CommandType::DRAW:
+				renderer.Submit({
+					command.mesh,
+					matrices_[command.first],
+					command.texture,
+					command.compact_mesh });
+				has_draws = true;
+				break;
+			case CommandType::DRAW_INSTANCED:
+				renderer.DrawInstanced(
+					*command.mesh,
+					BufferView<Instance>(
+						instances_.data() + command.first,
+						command.count),
+					view,
+					projection);
+				break;
+			}
+		}
+		flush();
+	}
+
+}	// End namespace SoftwareGL.
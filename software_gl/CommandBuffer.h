@@ -0,0 +1,80 @@
+#pragma once
+
+#include <vector>
+#include "BufferView.h"
+#include "Mesh.h"
+#include "QuantizedMesh.h"
+#include "Renderer.h"
+#include "TextureUnit.h"
+#include "VectorMath.h"
+#include "VertexProcessor.h"
+
+namespace SoftwareGL {
+
+	// Draws and state changes recorded for later, executed in order on a
+	// Renderer (directly or by the worker of a CommandQueue). A buffer is
+	// not shared by threads while it is recorded, each thread records its
+	// own. Matrices and instances are copied in, meshes and texture units
+	// are referenced and have to live until the buffer is executed. The
+	// buffer can be executed again as it is or Reset and recorded again,
+	// it keeps its capacity so a steady frame doesn't allocate.
+	class CommandBuffer
+	{
+	public:
+		// Forget the commands.
+		void Reset();
+		void Clear(const VectorMath::vector& color, const float z_max);
+		void SetTexture(const TextureUnit& unit, const unsigned int slot = 0);
+		// Camera of the draws that follow.
+		void SetCamera(
+			const VectorMath::matrix& view,
+			const VectorMath::matrix& projection);
+		// Object of the draw list of the renderer (see DrawItem), the ones
+		// recorded one after the other are culled and sorted together.
+		void Draw(
+			const Mesh& mesh,
+			const VectorMath::matrix& model,
+			const TextureUnit* texture = nullptr);
+		void Draw(
+			const QuantizedMesh& mesh,
+			const VectorMath::matrix& model,
+			const TextureUnit* texture = nullptr);
+		void DrawInstanced(
+			const Mesh& mesh,
+			const BufferView<Instance>& instances);
+
+	public:
+		// Run the commands on the calling thread.
+		void Execute(Renderer& renderer) const;
+		size_t GetCommandCount() const { return commands_.size(); }
+
+	private:
+		enum class CommandType
+		{
+			CLEAR,
+			SET_TEXTURE,
+			SET_CAMERA,
+			DRAW,
+			DRAW_INSTANCED,
+		};
+		// Arguments are indices in the arrays below.
+		struct Command
+		{
+			CommandType type;
+			unsigned int slot;
+			float z_max;
+			size_t first;
+			size_t count;
+			const Mesh* mesh;
+			const QuantizedMesh* compact_mesh;
+			const TextureUnit* texture;
+		};
+
+	private:
+		std::vector<Command> commands_ = {};
+		std::vector<VectorMath::vector> colors_ = {};
+		std::vector<VectorMath::matrix> matrices_ = {};
+		std::vector<Instance> instances_ = {};
+	};
+
+}	// End namespace SoftwareGL.
@@ -0,0 +1,65 @@
+#include "CommandQueue.h"
+
+namespace SoftwareGL {
+
+	CommandQueue::CommandQueue(Renderer& renderer) :
+		renderer_(renderer),
+		worker_(&CommandQueue::WorkerThread, this) {}
+
+	CommandQueue::~CommandQueue()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			stop_ = true;
+		}
+		condition_.notify_all();
+		if (worker_.joinable()) worker_.join();
+	}
+
+	void CommandQueue::Submit(const CommandBuffer& buffer)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			submitted_.push_back(&buffer);
+		}
+		condition_.notify_all();
+	}
+
+	void CommandQueue::Finish()
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		condition_.wait(lock, [this]
+		{
+			return submitted_.empty() && !busy_;
+		});
+	}
+
+	void CommandQueue::WorkerThread()
+	{
+		while (true)
+		{
+			{
+				std::unique_lock<std::mutex> lock(mutex_);
+				condition_.wait(lock, [this]
+				{
+					return stop_ || !submitted_.empty();
+				});
+				// What was submitted is still executed.
+				if (submitted_.empty()) return;
+				std::swap(submitted_, executing_);
+				busy_ = true;
+			}
+			for (const CommandBuffer* buffer : executing_)
+			{
+				buffer->Execute(renderer_);
+			}
+			executing_.clear();
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				busy_ = false;
+			}
+			condition_.notify_all();
+		}
+	}
+
+}	// End namespace SoftwareGL.
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "CommandBuffer.h"
+#include "Renderer.h"
+
+namespace SoftwareGL {
+
+	// Execute command buffers on a worker thread that owns the renderer
+	// between Submit and Finish, so the application thread goes on with
+	// the next frame (recording more buffers) while this one is drawn.
+	// Buffers are executed in the order they were submitted.
+	class CommandQueue
+	{
+	public:
+		explicit CommandQueue(Renderer& renderer);
+		CommandQueue(const CommandQueue&) = delete;
+		CommandQueue& operator=(const CommandQueue&) = delete;
+		virtual ~CommandQueue();
+
+	public:
+		// The buffer (and what it references) is not modified until the
+		// next Finish, Submit itself doesn't wait.
+		void Submit(const CommandBuffer& buffer);
+		// Wait until every submitted buffer is executed, the renderer can
+		// be used (its image read) again.
+		void Finish();
+
+	protected:
+		void WorkerThread();
+
+	private:
+		Renderer& renderer_;
+		// Shared, guarded by mutex_.
+		std::mutex mutex_;
+		std::condition_variable condition_;
+		std::vector<const CommandBuffer*> submitted_ = {};
+		bool busy_ = false;
+		bool stop_ = false;
+		// Worker only, swapped with submitted_ to keep both capacities.
+		std::vector<const CommandBuffer*> executing_ = {};
+		std::thread worker_;
+	};
+
+}	// End namespace SoftwareGL.
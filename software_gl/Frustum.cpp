@@ -0,0 +1,123 @@
+#include "Frustum.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace SoftwareGL {
+
+	BoundingVolume BoundingVolume::FromPositions(
+		const std::vector<VectorMath::vector4>& positions)
+	{
+		BoundingVolume bounds;
+		if (positions.empty()) return bounds;
+		bounds.aabb_min.fill(std::numeric_limits<float>::max());
+		bounds.aabb_max.fill(std::numeric_limits<float>::lowest());
+		for (const VectorMath::vector4& p : positions)
+		{
+			const std::array<float, 3> xyz = { p.x, p.y, p.z };
+			for (size_t k = 0; k < 3; ++k)
+			{
+				bounds.aabb_min[k] = std::min(bounds.aabb_min[k], xyz[k]);
+				bounds.aabb_max[k] = std::max(bounds.aabb_max[k], xyz[k]);
+			}
+		}
+		for (size_t k = 0; k < 3; ++k)
+		{
+			bounds.center[k] = (bounds.aabb_min[k] + bounds.aabb_max[k]) * .5f;
+		}
+		float radius_squared = 0.f;
+		for (const VectorMath::vector4& p : positions)
+		{
+			const float dx = p.x - bounds.center[0];
+			const float dy = p.y - bounds.center[1];
+			const float dz = p.z - bounds.center[2];
+			radius_squared =
+				std::max(radius_squared, dx * dx + dy * dy + dz * dz);
+		}
+		bounds.radius = std::sqrt(radius_squared);
+		return bounds;
+	}
+
+	Frustum::Frustum(const VectorMath::matrix& view_projection)
+	{
+		// With row vectors clip.x is the dot of the point with the first
+		// column and so on.
+		const VectorMath::matrix& m = view_projection;
+		const VectorMath::vector x(m._11, m._21, m._31, m._41);
+		const VectorMath::vector y(m._12, m._22, m._32, m._42);
+		const VectorMath::vector z(m._13, m._23, m._33, m._43);
+		const VectorMath::vector w(m._14, m._24, m._34, m._44);
+		planes_ = {
+			w + x,
+			w - x,
+			w + y,
+			w - y,
+			z,
+			w - z };
+		for (VectorMath::vector& plane : planes_)
+		{
+			const float length = std::sqrt(
+				plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+			if (length > 0.f) plane *= 1.f / length;
+		}
+	}
+
+	bool Frustum::IsOutside(
+		const BoundingVolume& bounds,
+		const VectorMath::matrix& model) const
+	{
+		if (bounds.empty()) return true;
+		const VectorMath::matrix& m = model;
+		// Largest scale of the model, for the radius.
+		const float scale = std::sqrt(std::max({
+			m._11 * m._11 + m._12 * m._12 + m._13 * m._13,
+			m._21 * m._21 + m._22 * m._22 + m._23 * m._23,
+			m._31 * m._31 + m._32 * m._32 + m._33 * m._33 }));
+		const VectorMath::vector center = VectorMath::VectorMult(
+			VectorMath::vector(
+				bounds.center[0],
+				bounds.center[1],
+				bounds.center[2],
+				1.f),
+			model);
+		const float radius = bounds.radius * scale;
+		bool inside = true;
+		for (const VectorMath::vector& plane : planes_)
+		{
+			const float distance =
+				plane.x * center.x +
+				plane.y * center.y +
+				plane.z * center.z +
+				plane.w;
+			if (distance < -radius) return true;
+			if (distance < radius) inside = false;
+		}
+		if (inside) return false;
+		// The sphere crosses a plane, try the box with the planes brought
+		// to model space, against the corner the furthest along the plane.
+		for (const VectorMath::vector& plane : planes_)
+		{
+			const float a =
+				m._11 * plane.x + m._12 * plane.y + m._13 * plane.z +
+				m._14 * plane.w;
+			const float b =
+				m._21 * plane.x + m._22 * plane.y + m._23 * plane.z +
+				m._24 * plane.w;
+			const float c =
+				m._31 * plane.x + m._32 * plane.y + m._33 * plane.z +
+				m._34 * plane.w;
+			const float d =
+				m._41 * plane.x + m._42 * plane.y + m._43 * plane.z +
+				m._44 * plane.w;
+			const float distance =
+				a * (a > 0.f ? bounds.aabb_max[0] : bounds.aabb_min[0]) +
+				b * (b > 0.f ? bounds.aabb_max[1] : bounds.aabb_min[1]) +
+				c * (c > 0.f ? bounds.aabb_max[2] : bounds.aabb_min[2]) +
+				d;
+			if (distance < 0.f) return true;
+		}
+		return false;
+	}
+
+}	// End namespace SoftwareGL.
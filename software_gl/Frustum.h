@@ -0,0 +1,51 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include "VectorMath.h"
+
+namespace SoftwareGL {
+
+	// Box and sphere around the positions of a mesh, in its model space.
+	// The sphere is centered on the box, as the one of MeshCluster.
+	struct BoundingVolume
+	{
+		std::array<float, 3> aabb_min = {};
+		std::array<float, 3> aabb_max = {};
+		std::array<float, 3> center = {};
+		// Negative when there is no position.
+		float radius = -1.f;
+
+		bool empty() const { return radius < 0.f; }
+		static BoundingVolume FromPositions(
+			const std::vector<VectorMath::vector4>& positions);
+	};
+
+	// Planes of the view volume of a view projection matrix, extracted from
+	// its columns (Gribb and Hartmann). The volume is the clip space of
+	// VectorMath::Projection: -w <= x, y <= w and 0 <= z <= w.
+	class Frustum
+	{
+	public:
+		Frustum() = default;
+		// Planes are in the space view_projection starts from.
+		explicit Frustum(const VectorMath::matrix& view_projection);
+
+	public:
+		// Bounds placed by model are completely outside of one plane (the
+		// sphere is tested first, then the box). Empty bounds are outside.
+		bool IsOutside(
+			const BoundingVolume& bounds,
+			const VectorMath::matrix& model) const;
+		// (a, b, c, d), a point is inside when a x + b y + c z + d >= 0
+		// for every plane, normalized so this is the distance.
+		const std::array<VectorMath::vector, 6>& GetPlanes() const
+		{
+			return planes_;
+		}
+
+	private:
+		std::array<VectorMath::vector, 6> planes_ = {};
+	};
+
+}	// End namespace SoftwareGL.
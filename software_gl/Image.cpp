@@ -1,10 +1,16 @@
 #include "Image.h"
 
 #include <algorithm>
-#include <fstream>
+#include <array>
+#include <cstring>
 #include <vector>
 #include <tuple>
 #include <assert.h>
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define SOFTWARE_GL_TGA_SSE2 1
+#endif
+#include "MappedFile.h"
 
 namespace SoftwareGL {
 
@@ -28,82 +34,287 @@ namespace SoftwareGL {
 		uint8_t image_descriptor;
 	};
 
-	bool Image::LoadFromTGA(const std::string& path)
-	{
-		std::ifstream ifs(path, std::ios::binary);
-		if (!ifs.is_open()) return false;
+	namespace {
 
-		ifs.seekg(0, std::ios_base::end);
-		size_t file_size = ifs.tellg();
-		ifs.seekg(0, std::ios_base::beg);
+		constexpr size_t tga_header_size = 18;
 
-		tga_header header;
-		// Fill up the header.
-		ifs.read((char*)&header.length, sizeof(uint8_t));
-		ifs.read((char*)&header.color_map_type, sizeof(uint8_t));
-		ifs.read((char*)&header.image_type, sizeof(uint8_t));
-		ifs.read((char*)&header.color_map_origin, sizeof(uint16_t));
-		ifs.read((char*)&header.color_map_length, sizeof(uint16_t));
-		ifs.read((char*)&header.color_map_entry_size, sizeof(uint8_t));
-		ifs.read((char*)&header.x_origin, sizeof(uint16_t));
-		ifs.read((char*)&header.y_origin, sizeof(uint16_t));
-		ifs.read((char*)&header.width, sizeof(uint16_t));
-		ifs.read((char*)&header.height, sizeof(uint16_t));
-		ifs.read((char*)&header.bits, sizeof(uint8_t));
-		ifs.read((char*)&header.image_descriptor, sizeof(uint8_t));
-		// Resize the buffer.
-		resize(header.width * header.height);
-		dx_ = header.width;
-		dy_ = header.height;
-		// Check the content.
-		switch (header.image_type) 
+		uint16_t ReadUInt16(const uint8_t* data)
 		{
-		case 2:
+			return static_cast<uint16_t>(data[0] | (data[1] << 8));
+		}
+
+		// Table from a byte to a normalized float, avoid a division per
+		// channel.
+		const std::array<float, 256>& ByteToFloat()
 		{
-			if (header.bits == 24)
+			static const std::array<float, 256> table = []
 			{
-				std::for_each(begin(), end(), [&ifs](VectorMath::vector& v) 
+				std::array<float, 256> t{};
+				for (int i = 0; i < 256; ++i)
 				{
-					uint8_t r;
-					uint8_t g;
-					uint8_t b;
-					ifs.read((char*)&b, sizeof(uint8_t));
-					ifs.read((char*)&g, sizeof(uint8_t));
-					ifs.read((char*)&r, sizeof(uint8_t));
-					v.x = static_cast<float>(r) / 255.f;
-					v.y = static_cast<float>(g) / 255.f;
-					v.z = static_cast<float>(b) / 255.f;
-					v.w = 1.f;
-				});
+					t[i] = static_cast<float>(i) / 255.f;
+				}
+				return t;
+			}();
+			return table;
+		}
+
+		// Convert count pixels of bytes_per_pixel from src (TGA order) to
+		// RGBA floats in dst, step is +1 or -1 (right to left images).
+		void DecodeRow(
+			const uint8_t* src,
+			VectorMath::vector* dst,
+			const size_t count,
+			const size_t bytes_per_pixel,
+			const bool gray,
+			const std::ptrdiff_t step)
+		{
+			const std::array<float, 256>& b2f = ByteToFloat();
+			if (gray)
+			{
+				for (size_t i = 0; i < count; ++i, dst += step)
+				{
+					const float l = b2f[src[i * bytes_per_pixel]];
+					const float a = (bytes_per_pixel == 2) ?
+						b2f[src[i * bytes_per_pixel + 1]] : 1.f;
+					*dst = VectorMath::vector(l, l, l, a);
+				}
+				return;
 			}
-			else if (header.bits == 32)
+			switch (bytes_per_pixel)
 			{
-				std::for_each(begin(), end(), [&ifs](VectorMath::vector& v)
+			case 2:
+			{
+				// A1R5G5B5 little endian.
+				for (size_t i = 0; i < count; ++i, dst += step)
 				{
-					uint8_t r;
-					uint8_t g;
-					uint8_t b;
-					uint8_t a;
-					// CHECKME: not sure of the order.
-					ifs.read((char*)&b, sizeof(uint8_t));
-					ifs.read((char*)&g, sizeof(uint8_t));
-					ifs.read((char*)&r, sizeof(uint8_t));
-					ifs.read((char*)&a, sizeof(uint8_t));
-					v.x = static_cast<float>(r) / 255.f;
-					v.y = static_cast<float>(g) / 255.f;
-					v.z = static_cast<float>(b) / 255.f;
-					v.w = static_cast<float>(a) / 255.f;
-				});
+					const uint16_t p = ReadUInt16(src + i * 2);
+					*dst = VectorMath::vector(
+						static_cast<float>((p >> 10) & 0x1f) / 31.f,
+						static_cast<float>((p >> 5) & 0x1f) / 31.f,
+						static_cast<float>(p & 0x1f) / 31.f,
+						1.f);
+				}
+				break;
 			}
-			else 
-			{ 
-				return false; 
+			case 3:
+			{
+				for (size_t i = 0; i < count; ++i, dst += step)
+				{
+					const uint8_t* p = src + i * 3;
+					*dst = VectorMath::vector(
+						b2f[p[2]], b2f[p[1]], b2f[p[0]], 1.f);
+				}
+				break;
 			}
-			break;
+			case 4:
+			{
+				size_t i = 0;
+#ifdef SOFTWARE_GL_TGA_SSE2
+				// Four BGRA pixels at a time, swizzled to RGBA floats.
+				if (step == 1)
+				{
+					const __m128i zero = _mm_setzero_si128();
+					const __m128 scale = _mm_set1_ps(1.f / 255.f);
+					float* out = reinterpret_cast<float*>(dst);
+					for (; i + 4 <= count; i += 4, out += 16)
+					{
+						const __m128i bytes = _mm_loadu_si128(
+							reinterpret_cast<const __m128i*>(src + i * 4));
+						const __m128i lo = _mm_unpacklo_epi8(bytes, zero);
+						const __m128i hi = _mm_unpackhi_epi8(bytes, zero);
+						const __m128i p[4] = {
+							_mm_unpacklo_epi16(lo, zero),
+							_mm_unpackhi_epi16(lo, zero),
+							_mm_unpacklo_epi16(hi, zero),
+							_mm_unpackhi_epi16(hi, zero) };
+						for (int j = 0; j < 4; ++j)
+						{
+							const __m128i rgba = _mm_shuffle_epi32(
+								p[j], _MM_SHUFFLE(3, 0, 1, 2));
+							_mm_storeu_ps(
+								out + j * 4,
+								_mm_mul_ps(_mm_cvtepi32_ps(rgba), scale));
+						}
+					}
+					dst += i;
+				}
+#endif // SOFTWARE_GL_TGA_SSE2
+				for (; i < count; ++i, dst += step)
+				{
+					const uint8_t* p = src + i * 4;
+					*dst = VectorMath::vector(
+						b2f[p[2]], b2f[p[1]], b2f[p[0]], b2f[p[3]]);
+				}
+				break;
+			}
+			default:
+				assert(false);
+			}
+		}
+
+		// Expand RLE packets into raw pixels, return false on truncated data.
+		bool DecodeRLE(
+			const uint8_t* src,
+			const uint8_t* src_end,
+			uint8_t* dst,
+			const size_t pixel_count,
+			const size_t bytes_per_pixel)
+		{
+			uint8_t* const dst_end = dst + pixel_count * bytes_per_pixel;
+			while (dst < dst_end)
+			{
+				if (src >= src_end) return false;
+				const uint8_t packet = *src++;
+				const size_t run = static_cast<size_t>(packet & 0x7f) + 1;
+				const size_t bytes = run * bytes_per_pixel;
+				if (bytes > static_cast<size_t>(dst_end - dst)) return false;
+				if (packet & 0x80)
+				{
+					if (bytes_per_pixel > static_cast<size_t>(src_end - src))
+					{
+						return false;
+					}
+					for (size_t i = 0; i < run; ++i)
+					{
+						std::memcpy(dst, src, bytes_per_pixel);
+						dst += bytes_per_pixel;
+					}
+					src += bytes_per_pixel;
+				}
+				else
+				{
+					if (bytes > static_cast<size_t>(src_end - src))
+					{
+						return false;
+					}
+					std::memcpy(dst, src, bytes);
+					dst += bytes;
+					src += bytes;
+				}
+			}
+			return true;
 		}
+
+	}	// End anonymous namespace.
+
+	bool Image::LoadFromTGA(const std::string& path)
+	{
+		MappedFile file;
+		if (!file.Open(path)) return false;
+		return LoadFromTGA(file.GetData(), file.GetSize());
+	}
+
+	bool Image::LoadFromTGA(const uint8_t* file_data, const size_t size)
+	{
+		const uint8_t* const data_end = file_data + size;
+		if (size < tga_header_size) return false;
+
+		tga_header header;
+		// Fill up the header.
+		header.length = file_data[0];
+		header.color_map_type = file_data[1];
+		header.image_type = file_data[2];
+		header.color_map_origin = ReadUInt16(file_data + 3);
+		header.color_map_length = ReadUInt16(file_data + 5);
+		header.color_map_entry_size = file_data[7];
+		header.x_origin = ReadUInt16(file_data + 8);
+		header.y_origin = ReadUInt16(file_data + 10);
+		header.width = ReadUInt16(file_data + 12);
+		header.height = ReadUInt16(file_data + 14);
+		header.bits = file_data[16];
+		header.image_descriptor = file_data[17];
+
+		// Check the content, 2 & 10 are true color and 3 & 11 are grayscale
+		// (raw and RLE respectively).
+		bool gray = false;
+		bool rle = false;
+		switch (header.image_type)
+		{
+		case 2:
+			break;
+		case 3:
+			gray = true;
+			break;
+		case 10:
+			rle = true;
+			break;
+		case 11:
+			gray = true;
+			rle = true;
+			break;
 		default:
 			return false;
 		}
+		if (gray && header.bits != 8 && header.bits != 16) return false;
+		if (!gray &&
+			header.bits != 16 &&
+			header.bits != 24 &&
+			header.bits != 32)
+		{
+			return false;
+		}
+		const size_t bytes_per_pixel = header.bits / 8;
+		const size_t width = header.width;
+		const size_t height = header.height;
+		const size_t pixel_count = width * height;
+
+		// Skip the image id and the (unused) color map.
+		size_t offset = tga_header_size + header.length;
+		if (header.color_map_type == 1)
+		{
+			offset +=
+				static_cast<size_t>(header.color_map_length) *
+				((header.color_map_entry_size + 7) / 8);
+		}
+		if (offset > size) return false;
+		const uint8_t* pixels = file_data + offset;
+
+		std::vector<uint8_t> expanded;
+		if (rle)
+		{
+			expanded.resize(pixel_count * bytes_per_pixel);
+			if (!DecodeRLE(
+				pixels,
+				data_end,
+				expanded.data(),
+				pixel_count,
+				bytes_per_pixel))
+			{
+				return false;
+			}
+			pixels = expanded.data();
+		}
+		else if (
+			pixel_count * bytes_per_pixel >
+			static_cast<size_t>(data_end - pixels))
+		{
+			return false;
+		}
+
+		// Resize the buffer.
+		resize(pixel_count);
+		dx_ = width;
+		dy_ = height;
+
+		// Rows are stored bottom up (as OpenGL expects) unless the origin
+		// bit says the file starts at the top.
+		const bool top_origin = (header.image_descriptor & 0x20) != 0;
+		const bool right_origin = (header.image_descriptor & 0x10) != 0;
+		const size_t row_size = width * bytes_per_pixel;
+		for (size_t y = 0; y < height; ++y)
+		{
+			const size_t row = top_origin ? height - 1 - y : y;
+			VectorMath::vector* dst = data() + row * width;
+			if (right_origin) dst += width - 1;
+			DecodeRow(
+				pixels + y * row_size,
+				dst,
+				width,
+				bytes_per_pixel,
+				gray,
+				right_origin ? -1 : 1);
+		}
 		return true;
 	}
 
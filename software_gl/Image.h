@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <vector>
 #include <string>
 #include "VectorMath.h"
@@ -21,6 +22,8 @@ namespace SoftwareGL {
 
 	public:
 		bool LoadFromTGA(const std::string& path);
+		// Decode a TGA file already in memory.
+		bool LoadFromTGA(const std::uint8_t* data, const size_t size);
 
 	public:
 		const std::pair<size_t, size_t> GetSize() const 
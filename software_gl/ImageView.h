@@ -0,0 +1,39 @@
+#pragma once
+
+#include <utility>
+#include "VectorMath.h"
+
+namespace SoftwareGL {
+
+	// Non owning view on RGBA float texels laid out like an Image, used to
+	// point into memory owned by something else (a mapped file for
+	// instance).
+	class ImageView
+	{
+	public:
+		ImageView() = default;
+		ImageView(const VectorMath::vector* data, size_t dx, size_t dy) :
+			data_(data), dx_(dx), dy_(dy) {}
+
+	public:
+		const VectorMath::vector& operator[](size_t index) const
+		{
+			return data_[index];
+		}
+		const VectorMath::vector* data() const { return data_; }
+		size_t size() const { return dx_ * dy_; }
+		bool empty() const { return size() == 0; }
+		const std::pair<size_t, size_t> GetSize() const
+		{
+			return std::make_pair(dx_, dy_);
+		}
+		float GetWidth() const { return static_cast<float>(dx_); }
+		float GetHeight() const { return static_cast<float>(dy_); }
+
+	private:
+		const VectorMath::vector* data_ = nullptr;
+		size_t dx_ = 0;
+		size_t dy_ = 0;
+	};
+
+}	// End namespace SoftwareGL.
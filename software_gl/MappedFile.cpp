@@ -0,0 +1,154 @@
+#include "MappedFile.h"
+
+#include <fstream>
+#include <utility>
+#if defined(_WIN32) | defined(_WIN64)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace SoftwareGL {
+
+	MappedFile::MappedFile(MappedFile&& file) noexcept
+	{
+		Swap(file);
+	}
+
+	MappedFile& MappedFile::operator=(MappedFile&& file) noexcept
+	{
+		if (this != &file)
+		{
+			Close();
+			Swap(file);
+		}
+		return *this;
+	}
+
+	MappedFile::~MappedFile()
+	{
+		Close();
+	}
+
+	bool MappedFile::Open(const std::string& path)
+	{
+		Close();
+#if defined(_WIN32) | defined(_WIN64)
+		HANDLE file = CreateFileA(
+			path.c_str(),
+			GENERIC_READ,
+			FILE_SHARE_READ,
+			nullptr,
+			OPEN_EXISTING,
+			FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+			nullptr);
+		if (file != INVALID_HANDLE_VALUE)
+		{
+			LARGE_INTEGER size;
+			HANDLE mapping = nullptr;
+			if (GetFileSizeEx(file, &size) && size.QuadPart > 0)
+			{
+				mapping = CreateFileMappingA(
+					file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			}
+			if (mapping)
+			{
+				void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+				if (view)
+				{
+					file_handle_ = file;
+					mapping_handle_ = mapping;
+					data_ = static_cast<const std::uint8_t*>(view);
+					size_ = static_cast<size_t>(size.QuadPart);
+					mapped_ = true;
+					return true;
+				}
+				CloseHandle(mapping);
+			}
+			CloseHandle(file);
+		}
+#else
+		int fd = open(path.c_str(), O_RDONLY);
+		if (fd >= 0)
+		{
+			struct stat st;
+			if (fstat(fd, &st) == 0 && st.st_size > 0)
+			{
+				void* view = mmap(
+					nullptr,
+					static_cast<size_t>(st.st_size),
+					PROT_READ,
+					MAP_PRIVATE,
+					fd,
+					0);
+				if (view != MAP_FAILED)
+				{
+					// The mapping stays valid after the descriptor is closed.
+					close(fd);
+					data_ = static_cast<const std::uint8_t*>(view);
+					size_ = static_cast<size_t>(st.st_size);
+					mapped_ = true;
+					return true;
+				}
+			}
+			close(fd);
+		}
+#endif
+		// Fall back to a single bulk read.
+		std::ifstream ifs(path, std::ios::binary | std::ios::ate);
+		if (!ifs.is_open()) return false;
+		const std::streamoff file_size = ifs.tellg();
+		if (file_size <= 0) return false;
+		buffer_.resize(static_cast<size_t>(file_size));
+		ifs.seekg(0, std::ios_base::beg);
+		if (!ifs.read(
+			reinterpret_cast<char*>(buffer_.data()),
+			static_cast<std::streamsize>(buffer_.size())))
+		{
+			buffer_.clear();
+			return false;
+		}
+		data_ = buffer_.data();
+		size_ = buffer_.size();
+		return true;
+	}
+
+	void MappedFile::Close()
+	{
+		if (mapped_)
+		{
+#if defined(_WIN32) | defined(_WIN64)
+			UnmapViewOfFile(data_);
+			CloseHandle(static_cast<HANDLE>(mapping_handle_));
+			CloseHandle(static_cast<HANDLE>(file_handle_));
+			mapping_handle_ = nullptr;
+			file_handle_ = nullptr;
+#else
+			munmap(const_cast<std::uint8_t*>(data_), size_);
+#endif
+		}
+		buffer_.clear();
+		buffer_.shrink_to_fit();
+		data_ = nullptr;
+		size_ = 0;
+		mapped_ = false;
+	}
+
+	void MappedFile::Swap(MappedFile& file) noexcept
+	{
+		std::swap(data_, file.data_);
+		std::swap(size_, file.size_);
+		std::swap(mapped_, file.mapped_);
+		std::swap(buffer_, file.buffer_);
+#if defined(_WIN32) | defined(_WIN64)
+		std::swap(file_handle_, file.file_handle_);
+		std::swap(mapping_handle_, file.mapping_handle_);
+#endif
+	}
+
+}	// End namespace SoftwareGL.
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace SoftwareGL {
+
+	// Read only view of a whole file, memory mapped when the platform allows
+	// it and bulk read into a buffer otherwise.
+	class MappedFile
+	{
+	public:
+		MappedFile() = default;
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+		MappedFile(MappedFile&& file) noexcept;
+		MappedFile& operator=(MappedFile&& file) noexcept;
+		virtual ~MappedFile();
+
+	public:
+		bool Open(const std::string& path);
+		void Close();
+		bool IsOpen() const { return data_ != nullptr; }
+		const std::uint8_t* GetData() const { return data_; }
+		size_t GetSize() const { return size_; }
+
+	protected:
+		void Swap(MappedFile& file) noexcept;
+
+	private:
+		const std::uint8_t* data_ = nullptr;
+		size_t size_ = 0;
+		bool mapped_ = false;
+		// Used when the file could not be mapped.
+		std::vector<std::uint8_t> buffer_ = {};
+#if defined(_WIN32) | defined(_WIN64)
+		void* file_handle_ = nullptr;
+		void* mapping_handle_ = nullptr;
+#endif
+	};
+
+}	// End namespace SoftwareGL.
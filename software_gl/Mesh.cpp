@@ -2,22 +2,637 @@
 
 #include <algorithm>
 #include <array>
+#include <charconv>
+#include <cmath>
+#include <cstring>
 #include <fstream>
+#include <limits>
 #include <sstream>
+#include <thread>
 #if defined(_WIN32) | defined(_WIN64)
 #include <execution>
 #endif
 #include <assert.h>
 
+#include "MappedFile.h"
+#include "MeshFile.h"
+#include "VectorBatch.h"
 #include "VectorMath.h"
 
 namespace SoftwareGL {
 
-	bool SoftwareGL::Mesh::LoadFromObj(const std::string& path)
+	namespace {
+
+		// Chunks smaller than this are not worth a thread.
+		constexpr size_t min_obj_chunk_size = 1024 * 1024;
+
+		// Arrays parsed from a newline aligned part of an OBJ file. Positive
+		// indices are global already, negative ones are resolved against the
+		// chunk counts and listed in relative_ to be rebased once the counts
+		// of the previous chunks are known.
+		struct ObjChunk
+		{
+			std::vector<VectorMath::vector4> positions;
+			std::vector<VectorMath::vector4> normals;
+			std::vector<VectorMath::vector3> textures;
+			std::vector<std::array<int, 3>> indices;
+			// Index * 3 + component of the relative entries in indices.
+			std::vector<size_t> relative;
+			bool ok = true;
+		};
+
+		bool IsBlank(const char c)
+		{
+			return c == ' ' || c == '\t';
+		}
+
+		bool IsLineEnd(const char c)
+		{
+			return c == '\n' || c == '\r' || c == '#';
+		}
+
+		const char* SkipBlanks(const char* p, const char* end)
+		{
+			while (p < end && IsBlank(*p)) ++p;
+			return p;
+		}
+
+		const char* NextLine(const char* p, const char* end)
+		{
+			const void* found = std::memchr(p, '\n', end - p);
+			if (!found) return end;
+			return static_cast<const char*>(found) + 1;
+		}
+
+		bool ParseFloat(const char*& p, const char* end, float& value)
+		{
+			p = SkipBlanks(p, end);
+			// from_chars doesn't accept an explicit plus sign.
+			if (p < end && *p == '+') ++p;
+			const auto result = std::from_chars(p, end, value);
+			if (result.ec != std::errc()) return false;
+			p = result.ptr;
+			return true;
+		}
+
+		// OBJ indices start at 1, negative ones are relative to the end of
+		// the list read so far. Returns -1 for a missing index.
+		bool ParseIndex(
+			const char*& p,
+			const char* end,
+			const size_t count,
+			int& index,
+			bool& relative)
+		{
+			index = -1;
+			relative = false;
+			if (p >= end || *p == '/' || IsBlank(*p) || IsLineEnd(*p))
+			{
+				return true;
+			}
+			int value = 0;
+			const auto result = std::from_chars(p, end, value);
+			if (result.ec != std::errc() || value == 0) return false;
+			p = result.ptr;
+			relative = value < 0;
+			index = relative ? static_cast<int>(count) + value : value - 1;
+			return true;
+		}
+
+		bool ParseFace(const char* p, const char* end, ObjChunk& chunk)
+		{
+			const size_t counts[3] = {
+				chunk.positions.size(),
+				chunk.textures.size(),
+				chunk.normals.size() };
+			// Polygons are split into a fan around the first corner.
+			std::array<int, 3> first = {};
+			std::array<int, 3> previous = {};
+			std::array<bool, 3> first_relative = {};
+			std::array<bool, 3> previous_relative = {};
+			int corner = 0;
+			while (true)
+			{
+				p = SkipBlanks(p, end);
+				if (p >= end || IsLineEnd(*p)) break;
+				std::array<int, 3> vi = { -1, -1, -1 };
+				std::array<bool, 3> relative = {};
+				for (int i = 0; i < 3; ++i)
+				{
+					if (i > 0)
+					{
+						if (p >= end || *p != '/') break;
+						++p;
+					}
+					if (!ParseIndex(p, end, counts[i], vi[i], relative[i]))
+					{
+						return false;
+					}
+				}
+				if (vi[0] == -1 && !relative[0]) return false;
+				if (corner >= 2)
+				{
+					const std::array<int, 3>* corners[3] =
+						{ &first, &previous, &vi };
+					const std::array<bool, 3>* relatives[3] =
+						{ &first_relative, &previous_relative, &relative };
+					for (int c = 0; c < 3; ++c)
+					{
+						for (int i = 0; i < 3; ++i)
+						{
+							if (!(*relatives[c])[i]) continue;
+							chunk.relative.push_back(
+								chunk.indices.size() * 3 + i);
+						}
+						chunk.indices.push_back(*corners[c]);
+					}
+				}
+				if (corner == 0)
+				{
+					first = vi;
+					first_relative = relative;
+				}
+				previous = vi;
+				previous_relative = relative;
+				++corner;
+			}
+			return corner >= 3;
+		}
+
+		void ParseObjChunk(const char* begin, const char* end, ObjChunk& chunk)
+		{
+			for (const char* p = begin; p < end; p = NextLine(p, end))
+			{
+				p = SkipBlanks(p, end);
+				if (p + 1 >= end) break;
+				if (p[0] == 'v' && IsBlank(p[1]))
+				{
+					VectorMath::vector4 v(0, 0, 0, 1);
+					p += 1;
+					chunk.ok =
+						ParseFloat(p, end, v.x) &&
+						ParseFloat(p, end, v.y) &&
+						ParseFloat(p, end, v.z);
+					chunk.positions.push_back(v);
+				}
+				else if (p[0] == 'v' && p[1] == 'n')
+				{
+					VectorMath::vector4 v(0, 0, 0, 1);
+					p += 2;
+					chunk.ok =
+						ParseFloat(p, end, v.x) &&
+						ParseFloat(p, end, v.y) &&
+						ParseFloat(p, end, v.z);
+					chunk.normals.push_back(v);
+				}
+				else if (p[0] == 'v' && p[1] == 't')
+				{
+					VectorMath::vector3 v(0, 0, 1);
+					p += 2;
+					chunk.ok =
+						ParseFloat(p, end, v.x) &&
+						ParseFloat(p, end, v.y);
+					chunk.textures.push_back(v);
+				}
+				else if (p[0] == 'f' && IsBlank(p[1]))
+				{
+					chunk.ok = ParseFace(p + 1, end, chunk);
+				}
+				// Anything else (comments, groups, materials) is ignored.
+				if (!chunk.ok) return;
+			}
+		}
+
+		// Run a function for every index on its own thread, the first one on
+		// the calling thread.
+		template <typename Function>
+		void ParallelFor(const size_t count, Function function)
+		{
+			std::vector<std::thread> threads;
+			for (size_t i = 1; i < count; ++i)
+			{
+				threads.emplace_back(function, i);
+			}
+			if (count > 0) function(0);
+			for (std::thread& thread : threads) thread.join();
+		}
+
+		// Split [0, count) into one range per core and run function(begin,
+		// end) on each of them.
+		template <typename Function>
+		void ParallelRanges(const size_t count, Function function)
+		{
+			constexpr size_t min_range_size = 16 * 1024;
+			const size_t range_count = std::clamp<size_t>(
+				count / min_range_size,
+				1,
+				std::max(1u, std::thread::hardware_concurrency()));
+			ParallelFor(range_count, [count, range_count, &function](
+				const size_t i)
+			{
+				function(
+					count * i / range_count,
+					count * (i + 1) / range_count);
+			});
+		}
+
+		// Transform the vectors in place, a block per task.
+		void AllMatrixMult(
+			std::vector<VectorMath::vector4>& vectors,
+			const VectorMath::matrix& matrix)
+		{
+			constexpr size_t block_size = VectorMath::batch_block_size;
+			std::vector<size_t> blocks;
+			VectorMath::ForEachBlock(
+				(vectors.size() + block_size - 1) / block_size,
+				blocks,
+				[&](const size_t block)
+			{
+				const size_t first = block * block_size;
+				VectorMath::VectorMultBatch(
+					&vectors[first],
+					matrix,
+					&vectors[first],
+					std::min(block_size, vectors.size() - first));
+			});
+		}
+
+		// Every float a Vertex is compared on.
+		constexpr size_t weld_key_size = 15;
+		using WeldKey = std::array<std::int64_t, weld_key_size>;
+
+		std::int64_t QuantizeComponent(const float value, const float tolerance)
+		{
+			if (tolerance > 0.f) return std::llround(value / tolerance);
+			// Exact match, only 0 and -0 are merged.
+			if (value == 0.f) return 0;
+			std::int32_t bits = 0;
+			std::memcpy(&bits, &value, sizeof(bits));
+			return bits;
+		}
+
+		WeldKey MakeWeldKey(const Vertex& vertex, const float tolerance)
+		{
+			const VectorMath::vector4 position = vertex.GetPosition();
+			const VectorMath::vector4 color = vertex.GetColor();
+			const VectorMath::vector4 normal = vertex.GetNormal();
+			const VectorMath::vector3 texture = vertex.GetTexture();
+			const float values[weld_key_size] = {
+				position.x, position.y, position.z, position.w,
+				color.x, color.y, color.z, color.w,
+				normal.x, normal.y, normal.z, normal.w,
+				texture.x, texture.y, texture.z };
+			WeldKey key;
+			for (size_t i = 0; i < weld_key_size; ++i)
+			{
+				key[i] = QuantizeComponent(values[i], tolerance);
+			}
+			return key;
+		}
+
+		std::uint64_t HashWeldKey(const WeldKey& key)
+		{
+			std::uint64_t hash = 14695981039346656037ull;
+			for (const std::int64_t value : key)
+			{
+				hash ^= static_cast<std::uint64_t>(value);
+				hash *= 1099511628211ull;
+				hash ^= hash >> 29;
+			}
+			return hash;
+		}
+
+		// Triangle order for a post-transform vertex cache, after Tom
+		// Forsyth's "Linear-Speed Vertex Cache Optimisation": vertices score
+		// higher when they are recent in the cache and when they have few
+		// triangles left, the best triangle around the cache goes next.
+		class VertexCacheOrder
+		{
+		public:
+			static constexpr int cache_size = 32;
+
+		public:
+			VertexCacheOrder(
+				const std::vector<std::uint32_t>& indices,
+				const size_t vertex_count) :
+				indices_(indices),
+				triangle_count_(indices.size() / 3),
+				offsets_(vertex_count + 1, 0),
+				live_(vertex_count, 0),
+				cache_position_(vertex_count, -1),
+				vertex_scores_(vertex_count, 0.f),
+				triangle_scores_(indices.size() / 3, 0.f),
+				emitted_(indices.size() / 3, 0) {}
+
+		public:
+			std::vector<std::uint32_t> Compute()
+			{
+				// Triangles around every vertex.
+				for (const std::uint32_t index : indices_)
+				{
+					++offsets_[index + 1];
+				}
+				for (size_t i = 1; i < offsets_.size(); ++i)
+				{
+					live_[i - 1] = offsets_[i];
+					offsets_[i] += offsets_[i - 1];
+				}
+				adjacency_.resize(indices_.size());
+				std::vector<std::uint32_t> fill(
+					offsets_.begin(),
+					offsets_.end() - 1);
+				for (size_t i = 0; i < indices_.size(); ++i)
+				{
+					adjacency_[fill[indices_[i]]++] =
+						static_cast<std::uint32_t>(i / 3);
+				}
+				for (size_t v = 0; v < live_.size(); ++v)
+				{
+					vertex_scores_[v] = Score(v);
+				}
+				int best = -1;
+				for (size_t t = 0; t < triangle_count_; ++t)
+				{
+					triangle_scores_[t] = TriangleScore(t);
+					if (best < 0 ||
+						triangle_scores_[t] > triangle_scores_[best])
+					{
+						best = static_cast<int>(t);
+					}
+				}
+				std::vector<std::uint32_t> order;
+				order.reserve(triangle_count_);
+				size_t next_unemitted = 0;
+				while (order.size() < triangle_count_)
+				{
+					if (best < 0)
+					{
+						// Nothing left around the cache, restart anywhere.
+						while (emitted_[next_unemitted]) ++next_unemitted;
+						best = static_cast<int>(next_unemitted);
+					}
+					order.push_back(static_cast<std::uint32_t>(best));
+					best = Emit(static_cast<size_t>(best));
+				}
+				return order;
+			}
+
+		protected:
+			float Score(const size_t vertex) const
+			{
+				if (live_[vertex] == 0) return -1.f;
+				float score = 0.f;
+				const int position = cache_position_[vertex];
+				if (position >= 0 && position < 3)
+				{
+					// Vertices of the last triangle, don't favor them too
+					// much or the strips turn back on themselves.
+					score = .75f;
+				}
+				else if (position >= 3)
+				{
+					score = std::pow(
+						1.f - (position - 3) / float(cache_size - 3),
+						1.5f);
+				}
+				// Finish the vertices with few triangles left first.
+				return score + 2.f / std::sqrt(float(live_[vertex]));
+			}
+
+			float TriangleScore(const size_t triangle) const
+			{
+				return
+					vertex_scores_[indices_[triangle * 3]] +
+					vertex_scores_[indices_[triangle * 3 + 1]] +
+					vertex_scores_[indices_[triangle * 3 + 2]];
+			}
+
+			// Return the best triangle around the cache or -1.
+			int Emit(const size_t triangle)
+			{
+				emitted_[triangle] = 1;
+				// Build the new cache in the scratch one and swap them, so
+				// neither is reallocated per triangle.
+				std::vector<std::uint32_t>& cache = next_cache_;
+				cache.clear();
+				cache.reserve(cache_size + 3);
+				for (size_t i = 0; i < 3; ++i)
+				{
+					const std::uint32_t v = indices_[triangle * 3 + i];
+					// Remove the triangle from the live ones of the vertex.
+					const size_t begin = offsets_[v];
+					const size_t end = begin + live_[v];
+					for (size_t j = begin; j < end; ++j)
+					{
+						if (adjacency_[j] == triangle)
+						{
+							std::swap(adjacency_[j], adjacency_[end - 1]);
+							break;
+						}
+					}
+					--live_[v];
+					if (std::find(cache.begin(), cache.end(), v) == cache.end())
+					{
+						cache.push_back(v);
+					}
+				}
+				for (const std::uint32_t v : cache_)
+				{
+					if (std::find(cache.begin(), cache.end(), v) == cache.end())
+					{
+						cache.push_back(v);
+					}
+				}
+				// Update the vertices that moved, fell out of the cache or
+				// lost a triangle, then the triangles around them.
+				for (size_t i = 0; i < cache.size(); ++i)
+				{
+					const int position =
+						(i < cache_size) ? static_cast<int>(i) : -1;
+					cache_position_[cache[i]] = position;
+					vertex_scores_[cache[i]] = Score(cache[i]);
+				}
+				int best = -1;
+				float best_score = -1.f;
+				for (const std::uint32_t v : cache)
+				{
+					const size_t begin = offsets_[v];
+					for (size_t j = begin; j < begin + live_[v]; ++j)
+					{
+						const size_t t = adjacency_[j];
+						triangle_scores_[t] = TriangleScore(t);
+						if (triangle_scores_[t] > best_score)
+						{
+							best_score = triangle_scores_[t];
+							best = static_cast<int>(t);
+						}
+					}
+				}
+				if (cache.size() > cache_size) cache.resize(cache_size);
+				cache_.swap(next_cache_);
+				return best;
+			}
+
+		private:
+			const std::vector<std::uint32_t>& indices_;
+			const size_t triangle_count_;
+			std::vector<std::uint32_t> offsets_;
+			std::vector<std::uint32_t> adjacency_ = {};
+			std::vector<std::uint32_t> live_;
+			std::vector<int> cache_position_;
+			std::vector<float> vertex_scores_;
+			std::vector<float> triangle_scores_;
+			std::vector<std::uint8_t> emitted_;
+			std::vector<std::uint32_t> cache_ = {};
+			std::vector<std::uint32_t> next_cache_ = {};
+		};
+
+		// Number of each value in the order it is first met, values never met
+		// are numbered last.
+		std::vector<std::uint32_t> FirstUseRemap(
+			const std::vector<std::uint32_t>& values,
+			const size_t count)
+		{
+			constexpr std::uint32_t unused =
+				std::numeric_limits<std::uint32_t>::max();
+			std::vector<std::uint32_t> remap(count, unused);
+			std::uint32_t next = 0;
+			for (const std::uint32_t value : values)
+			{
+				if (remap[value] == unused) remap[value] = next++;
+			}
+			for (std::uint32_t& value : remap)
+			{
+				if (value == unused) value = next++;
+			}
+			return remap;
+		}
+
+		template <typename T>
+		void ApplyRemap(
+			std::vector<T>& values,
+			const std::vector<std::uint32_t>& remap,
+			const size_t stride = 1)
+		{
+			std::vector<T> result(values.size());
+			for (size_t i = 0; i < remap.size(); ++i)
+			{
+				std::copy(
+					values.begin() + i * stride,
+					values.begin() + (i + 1) * stride,
+					result.begin() + remap[i] * stride);
+			}
+			values = std::move(result);
+		}
+
+	}	// End anonymous namespace.
+
+	bool Mesh::LoadFromObj(const std::string& path)
+	{
+		MappedFile file;
+		if (!file.Open(path)) return false;
+		return LoadFromObj(
+			reinterpret_cast<const char*>(file.GetData()),
+			file.GetSize());
+	}
+
+	bool Mesh::LoadFromObj(const char* data, const size_t size)
+	{
+		Clear();
+		const char* end = data + size;
+		// Split the file in newline aligned chunks, one per core.
+		const size_t chunk_count = std::clamp<size_t>(
+			size / min_obj_chunk_size,
+			1,
+			std::max(1u, std::thread::hardware_concurrency()));
+		std::vector<const char*> bounds(chunk_count + 1, end);
+		bounds[0] = data;
+		for (size_t i = 1; i < chunk_count; ++i)
+		{
+			bounds[i] = std::max(
+				bounds[i - 1],
+				NextLine(data + size * i / chunk_count, end));
+		}
+		std::vector<ObjChunk> chunks(chunk_count);
+		ParallelFor(chunk_count, [&bounds, &chunks](const size_t i)
+		{
+			ParseObjChunk(bounds[i], bounds[i + 1], chunks[i]);
+		});
+
+		// Prefix sums give the place of every chunk in the final arrays.
+		std::vector<std::array<size_t, 4>> offsets(chunk_count + 1);
+		for (size_t i = 0; i < chunk_count; ++i)
+		{
+			if (!chunks[i].ok) return false;
+			offsets[i + 1] = {
+				offsets[i][0] + chunks[i].positions.size(),
+				offsets[i][1] + chunks[i].textures.size(),
+				offsets[i][2] + chunks[i].normals.size(),
+				offsets[i][3] + chunks[i].indices.size() };
+		}
+		const std::array<size_t, 4>& totals = offsets[chunk_count];
+		positions_.resize(totals[0]);
+		textures_.resize(totals[1]);
+		normals_.resize(totals[2]);
+		indices_.resize(totals[3]);
+		ParallelFor(chunk_count, [this, &chunks, &offsets](const size_t i)
+		{
+			ObjChunk& chunk = chunks[i];
+			const std::array<size_t, 4>& offset = offsets[i];
+			std::copy(
+				chunk.positions.begin(),
+				chunk.positions.end(),
+				positions_.begin() + offset[0]);
+			std::copy(
+				chunk.textures.begin(),
+				chunk.textures.end(),
+				textures_.begin() + offset[1]);
+			std::copy(
+				chunk.normals.begin(),
+				chunk.normals.end(),
+				normals_.begin() + offset[2]);
+			for (const size_t entry : chunk.relative)
+			{
+				chunk.indices[entry / 3][entry % 3] +=
+					static_cast<int>(offset[entry % 3]);
+			}
+			// Reject indices outside of their list.
+			for (const std::array<int, 3>& vi : chunk.indices)
+			{
+				if (vi[0] < 0 ||
+					vi[0] >= static_cast<int>(positions_.size()) ||
+					vi[1] < -1 ||
+					vi[1] >= static_cast<int>(textures_.size()) ||
+					vi[2] < -1 ||
+					vi[2] >= static_cast<int>(normals_.size()))
+				{
+					chunk.ok = false;
+					break;
+				}
+			}
+			std::copy(
+				chunk.indices.begin(),
+				chunk.indices.end(),
+				indices_.begin() + offset[3]);
+		});
+		for (const ObjChunk& chunk : chunks)
+		{
+			if (!chunk.ok)
+			{
+				Clear();
+				return false;
+			}
+		}
+		ComputeBounds();
+		return true;
+	}
+
+	bool Mesh::LoadFromObjStream(const std::string& path)
 	{
 		std::ifstream ifs;
 		ifs.open(path, std::ifstream::in);
 		if (!ifs.is_open())	return false;
+		Clear();
 		while (!ifs.eof()) {
 			std::string line = "";
 			if (!std::getline(ifs, line)) break;
@@ -98,10 +713,67 @@ namespace SoftwareGL {
 			}
 		}
 		if (indices_.size() % 3 != 0) return false;
+		ComputeBounds();
 		return true;
 	}
 
-	inline const std::vector<VectorMath::vector4>& Mesh::GetPositions() const
+	bool Mesh::LoadFromMeshFile(const std::string& path)
+	{
+		MeshFile file;
+		if (!file.Open(path)) return false;
+		return LoadFromMeshFile(file, true);
+	}
+
+	bool Mesh::LoadFromMeshFile(const MeshFile& file, const bool with_flat)
+	{
+		const auto assign = [](auto& vec, const auto& view)
+		{
+			vec.assign(view.begin(), view.end());
+		};
+		const auto assign_flat = [with_flat](auto& vec, const auto& view)
+		{
+			if (with_flat)
+			{
+				vec.assign(view.begin(), view.end());
+			}
+			else
+			{
+				vec.clear();
+			}
+		};
+		assign(positions_, file.GetPositions());
+		assign(normals_, file.GetNormals());
+		assign(textures_, file.GetTextures());
+		assign(indices_, file.GetIndices());
+		assign_flat(flat_positions_, file.GetFlatPositions());
+		assign_flat(flat_normals_, file.GetFlatNormals());
+		assign_flat(flat_textures_, file.GetFlatTextures());
+		assign_flat(flat_indices_, file.GetFlatIndices());
+		assign(clusters_, file.GetClusters());
+		ComputeBounds();
+		return true;
+	}
+
+	void Mesh::Clear()
+	{
+		positions_.clear();
+		normals_.clear();
+		textures_.clear();
+		indices_.clear();
+		flat_positions_.clear();
+		flat_normals_.clear();
+		flat_textures_.clear();
+		flat_indices_.clear();
+		clusters_.clear();
+		bounds_ = {};
+	}
+
+	void Mesh::ComputeBounds()
+	{
+		bounds_ = BoundingVolume::FromPositions(positions_);
+	}
+
+	const std::vector<VectorMath::vector4>& Mesh::GetPositions() const
 	{
 		return positions_;
 	}
@@ -121,46 +793,470 @@ namespace SoftwareGL {
 		return indices_;
 	}
 
-	void Mesh::ComputeFlat()
+	void Mesh::ComputeFlat(const float tolerance /*= 0.f*/)
 	{
-		std::vector<SoftwareGL::Vertex> vertices;
-		for (const SoftwareGL::Triangle& triangle : *this)
+		const size_t corner_count = indices_.size() - indices_.size() % 3;
+		assert(corner_count < std::numeric_limits<std::uint32_t>::max());
+		// Corners as the renderer sees them (with the face normal when there
+		// is none) and the hash of their key.
+		std::vector<Vertex> corners(corner_count);
+		std::vector<std::uint64_t> hashes(corner_count);
+		ParallelRanges(corner_count / 3, [&](size_t begin, size_t end)
 		{
-			auto lambda = [&vertices](const Vertex& v)
+			for (size_t i = begin; i < end; ++i)
 			{
-				auto next =
-					static_cast<unsigned int>(vertices.size());
-				auto it = std::find(vertices.begin(), vertices.end(), v);
-				if (it == vertices.end())
+				const Triangle triangle = GetTriangle(i).ToTriangle();
+				corners[i * 3] = triangle.GetV1();
+				corners[i * 3 + 1] = triangle.GetV2();
+				corners[i * 3 + 2] = triangle.GetV3();
+				for (size_t j = i * 3; j < i * 3 + 3; ++j)
 				{
-					vertices.push_back(v);
+					hashes[j] = HashWeldKey(MakeWeldKey(corners[j], tolerance));
 				}
-				else
+			}
+		});
+		// Open addressing table holding the first corner of every vertex,
+		// filled in order so vertices are numbered by first use.
+		constexpr std::uint32_t empty_slot =
+			std::numeric_limits<std::uint32_t>::max();
+		size_t table_size = 1;
+		while (table_size < corner_count * 2) table_size <<= 1;
+		std::vector<std::uint32_t> table(table_size, empty_slot);
+		std::vector<std::uint32_t> first_corners;
+		flat_indices_.resize(corner_count);
+		for (size_t i = 0; i < corner_count; ++i)
+		{
+			const WeldKey key = MakeWeldKey(corners[i], tolerance);
+			size_t slot = hashes[i] & (table_size - 1);
+			while (true)
+			{
+				const std::uint32_t other = table[slot];
+				if (other == empty_slot)
+				{
+					table[slot] = static_cast<std::uint32_t>(i);
+					flat_indices_[i] =
+						static_cast<unsigned int>(first_corners.size());
+					first_corners.push_back(static_cast<std::uint32_t>(i));
+					break;
+				}
+				if (hashes[other] == hashes[i] &&
+					MakeWeldKey(corners[other], tolerance) == key)
 				{
-					next =
-						static_cast<unsigned int>(
-							std::distance(vertices.begin(), it));
-				}
-				return next;
-			};
-			flat_indices_.push_back(lambda(triangle.GetV1()));
-			flat_indices_.push_back(lambda(triangle.GetV2()));
-			flat_indices_.push_back(lambda(triangle.GetV3()));
-		}
-		for (const SoftwareGL::Vertex& vertex : vertices)
-		{
-			auto point = vertex.GetPosition();
-			auto normal = vertex.GetNormal();
-			auto texel = vertex.GetTexture();
-			flat_positions_.push_back(point.x);
-			flat_positions_.push_back(point.y);
-			flat_positions_.push_back(point.z);
-			flat_normals_.push_back(normal.x);
-			flat_normals_.push_back(normal.y);
-			flat_normals_.push_back(normal.z);
-			flat_textures_.push_back(texel.x);
-			flat_textures_.push_back(texel.y);
+					flat_indices_[i] = flat_indices_[other];
+					break;
+				}
+				slot = (slot + 1) & (table_size - 1);
+			}
 		}
+		flat_positions_.resize(first_corners.size() * 3);
+		flat_normals_.resize(first_corners.size() * 3);
+		flat_textures_.resize(first_corners.size() * 2);
+		ParallelRanges(first_corners.size(), [&](size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; ++i)
+			{
+				const Vertex& vertex = corners[first_corners[i]];
+				const auto point = vertex.GetPosition();
+				const auto normal = vertex.GetNormal();
+				const auto texel = vertex.GetTexture();
+				flat_positions_[i * 3] = point.x;
+				flat_positions_[i * 3 + 1] = point.y;
+				flat_positions_[i * 3 + 2] = point.z;
+				flat_normals_[i * 3] = normal.x;
+				flat_normals_[i * 3 + 1] = normal.y;
+				flat_normals_[i * 3 + 2] = normal.z;
+				flat_textures_[i * 2] = texel.x;
+				flat_textures_[i * 2 + 1] = texel.y;
+			}
+		});
+	}
+
+	void Mesh::Optimize()
+	{
+		clusters_.clear();
+		const size_t triangle_count = indices_.size() / 3;
+		if (triangle_count == 0) return;
+		const bool has_flat = flat_indices_.size() == indices_.size();
+		// Vertices are the welded ones if any, the positions otherwise.
+		std::vector<std::uint32_t> vertices(indices_.size());
+		for (size_t i = 0; i < indices_.size(); ++i)
+		{
+			vertices[i] = has_flat ?
+				flat_indices_[i] :
+				static_cast<std::uint32_t>(indices_[i][0]);
+		}
+		const size_t vertex_count =
+			has_flat ? flat_positions_.size() / 3 : positions_.size();
+		const std::vector<std::uint32_t> order =
+			VertexCacheOrder(vertices, vertex_count).Compute();
+
+		// Cut the order where the cache restarts (a triangle missing its
+		// three vertices) and draw first the clusters that face away from
+		// the center of the mesh, from any view they are the most likely
+		// to hide the others (Sander et al., "Fast Triangle Reordering for
+		// Vertex Locality and Reduced Overdraw").
+		struct Cluster
+		{
+			size_t begin;
+			size_t end;
+			std::array<float, 3> center;
+			std::array<float, 3> normal;
+			float area;
+			float key;
+		};
+		constexpr size_t fifo_size = 16;
+		std::vector<size_t> stamps(vertex_count, 0);
+		size_t time = fifo_size + 1;
+		std::vector<Cluster> clusters;
+		std::array<float, 3> mesh_center = {};
+		float mesh_area = 0.f;
+		for (size_t i = 0; i < order.size(); ++i)
+		{
+			int misses = 0;
+			for (size_t j = 0; j < 3; ++j)
+			{
+				const std::uint32_t v = vertices[order[i] * 3 + j];
+				if (time - stamps[v] > fifo_size)
+				{
+					stamps[v] = time++;
+					++misses;
+				}
+			}
+			if (misses == 3 || clusters.empty())
+			{
+				clusters.push_back({ i, i, {}, {}, 0.f, 0.f });
+			}
+			Cluster& cluster = clusters.back();
+			cluster.end = i + 1;
+			const auto& p0 = positions_[indices_[order[i] * 3][0]];
+			const auto& p1 = positions_[indices_[order[i] * 3 + 1][0]];
+			const auto& p2 = positions_[indices_[order[i] * 3 + 2][0]];
+			const std::array<float, 3> e1 =
+				{ p1.x - p0.x, p1.y - p0.y, p1.z - p0.z };
+			const std::array<float, 3> e2 =
+				{ p2.x - p0.x, p2.y - p0.y, p2.z - p0.z };
+			const std::array<float, 3> cross = {
+				e1[1] * e2[2] - e1[2] * e2[1],
+				e1[2] * e2[0] - e1[0] * e2[2],
+				e1[0] * e2[1] - e1[1] * e2[0] };
+			const float area = std::sqrt(
+				cross[0] * cross[0] +
+				cross[1] * cross[1] +
+				cross[2] * cross[2]);
+			const std::array<float, 3> center = {
+				(p0.x + p1.x + p2.x) / 3.f,
+				(p0.y + p1.y + p2.y) / 3.f,
+				(p0.z + p1.z + p2.z) / 3.f };
+			for (size_t k = 0; k < 3; ++k)
+			{
+				cluster.center[k] += center[k] * area;
+				cluster.normal[k] += cross[k];
+				mesh_center[k] += center[k] * area;
+			}
+			cluster.area += area;
+			mesh_area += area;
+		}
+		for (float& c : mesh_center) c /= std::max(mesh_area, 1e-20f);
+		for (Cluster& cluster : clusters)
+		{
+			const float length = std::sqrt(
+				cluster.normal[0] * cluster.normal[0] +
+				cluster.normal[1] * cluster.normal[1] +
+				cluster.normal[2] * cluster.normal[2]);
+			if (cluster.area <= 0.f || length <= 0.f) continue;
+			for (size_t k = 0; k < 3; ++k)
+			{
+				cluster.key +=
+					(cluster.center[k] / cluster.area - mesh_center[k]) *
+					cluster.normal[k] / length;
+			}
+		}
+		std::stable_sort(
+			clusters.begin(),
+			clusters.end(),
+			[](const Cluster& a, const Cluster& b)
+		{
+			return a.key > b.key;
+		});
+
+		// Move the triangles of both index lists, they stay in step.
+		std::vector<std::array<int, 3>> indices;
+		std::vector<unsigned int> flat_indices;
+		indices.reserve(indices_.size());
+		flat_indices.reserve(flat_indices_.size());
+		for (const Cluster& cluster : clusters)
+		{
+			for (size_t i = cluster.begin; i < cluster.end; ++i)
+			{
+				for (size_t j = order[i] * 3; j < order[i] * 3 + 3; ++j)
+				{
+					indices.push_back(indices_[j]);
+					if (has_flat) flat_indices.push_back(flat_indices_[j]);
+				}
+			}
+		}
+		indices_ = std::move(indices);
+		if (has_flat) flat_indices_ = std::move(flat_indices);
+
+		// Number the vertices in the order they are fetched.
+		if (has_flat)
+		{
+			const std::vector<std::uint32_t> remap = FirstUseRemap(
+				std::vector<std::uint32_t>(
+					flat_indices_.begin(),
+					flat_indices_.end()),
+				vertex_count);
+			ApplyRemap(flat_positions_, remap, 3);
+			ApplyRemap(flat_normals_, remap, 3);
+			ApplyRemap(flat_textures_, remap, 2);
+			for (unsigned int& index : flat_indices_) index = remap[index];
+		}
+		const size_t counts[3] =
+			{ positions_.size(), textures_.size(), normals_.size() };
+		for (size_t k = 0; k < 3; ++k)
+		{
+			std::vector<std::uint32_t> used;
+			used.reserve(indices_.size());
+			for (const std::array<int, 3>& vi : indices_)
+			{
+				if (vi[k] >= 0) used.push_back(vi[k]);
+			}
+			const std::vector<std::uint32_t> remap =
+				FirstUseRemap(used, counts[k]);
+			if (k == 0) ApplyRemap(positions_, remap);
+			if (k == 1) ApplyRemap(textures_, remap);
+			if (k == 2) ApplyRemap(normals_, remap);
+			for (std::array<int, 3>& vi : indices_)
+			{
+				if (vi[k] >= 0) vi[k] = static_cast<int>(remap[vi[k]]);
+			}
+		}
+	}
+
+	void Mesh::BuildClusters(const size_t max_triangles /*= 128*/)
+	{
+		assert(max_triangles > 0);
+		clusters_.clear();
+		const size_t triangle_count = indices_.size() / 3;
+		if (triangle_count == 0) return;
+		const bool has_flat = flat_indices_.size() == indices_.size();
+		const auto position = [this](size_t triangle, size_t corner)
+		{
+			return positions_[indices_[triangle * 3 + corner][0]];
+		};
+		// Unit face normals, 0 for a degenerate triangle.
+		std::vector<std::array<float, 3>> normals(triangle_count);
+		for (size_t t = 0; t < triangle_count; ++t)
+		{
+			const auto& p0 = position(t, 0);
+			const auto& p1 = position(t, 1);
+			const auto& p2 = position(t, 2);
+			const std::array<float, 3> e1 =
+				{ p1.x - p0.x, p1.y - p0.y, p1.z - p0.z };
+			const std::array<float, 3> e2 =
+				{ p2.x - p0.x, p2.y - p0.y, p2.z - p0.z };
+			std::array<float, 3> n = {
+				e1[1] * e2[2] - e1[2] * e2[1],
+				e1[2] * e2[0] - e1[0] * e2[2],
+				e1[0] * e2[1] - e1[1] * e2[0] };
+			const float length = std::sqrt(
+				n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+			if (length > 0.f)
+			{
+				for (float& c : n) c /= length;
+			}
+			normals[t] = n;
+		}
+		// Triangles around every position.
+		std::vector<std::uint32_t> offsets(positions_.size() + 1, 0);
+		for (const std::array<int, 3>& vi : indices_) ++offsets[vi[0] + 1];
+		for (size_t i = 1; i < offsets.size(); ++i)
+		{
+			offsets[i] += offsets[i - 1];
+		}
+		std::vector<std::uint32_t> adjacency(indices_.size());
+		{
+			std::vector<std::uint32_t> fill(
+				offsets.begin(),
+				offsets.end() - 1);
+			for (size_t i = 0; i < indices_.size(); ++i)
+			{
+				adjacency[fill[indices_[i][0]]++] =
+					static_cast<std::uint32_t>(i / 3);
+			}
+		}
+
+		// Grow every cluster from the first free triangle, always taking
+		// the candidate sharing the most vertices with it. The ones that
+		// bend too far from its mean normal (cos 60) are only taken while
+		// the cluster is small (noisy surfaces would end up in clusters
+		// costing more to test than they save).
+		constexpr float min_alignment = .5f;
+		const size_t min_triangles = std::max<size_t>(1, max_triangles / 4);
+		constexpr std::uint32_t none =
+			std::numeric_limits<std::uint32_t>::max();
+		std::vector<std::uint32_t> cluster_of(triangle_count, none);
+		std::vector<std::uint32_t> candidate_of(triangle_count, none);
+		std::vector<std::uint32_t> vertex_of(positions_.size(), none);
+		std::vector<std::vector<std::uint32_t>> members;
+		std::vector<std::uint32_t> candidates;
+		for (size_t seed = 0; seed < triangle_count; ++seed)
+		{
+			if (cluster_of[seed] != none) continue;
+			const std::uint32_t id =
+				static_cast<std::uint32_t>(members.size());
+			members.push_back({});
+			std::vector<std::uint32_t>& cluster = members.back();
+			std::array<float, 3> sum = {};
+			candidates.clear();
+			std::uint32_t next = static_cast<std::uint32_t>(seed);
+			while (next != none)
+			{
+				cluster_of[next] = id;
+				cluster.push_back(next);
+				for (size_t k = 0; k < 3; ++k) sum[k] += normals[next][k];
+				for (size_t j = 0; j < 3; ++j)
+				{
+					const int v = indices_[next * 3 + j][0];
+					vertex_of[v] = id;
+					for (std::uint32_t a = offsets[v]; a < offsets[v + 1]; ++a)
+					{
+						const std::uint32_t t = adjacency[a];
+						if (cluster_of[t] != none || candidate_of[t] == id)
+						{
+							continue;
+						}
+						candidate_of[t] = id;
+						candidates.push_back(t);
+					}
+				}
+				if (cluster.size() >= max_triangles) break;
+				const float length = std::sqrt(
+					sum[0] * sum[0] + sum[1] * sum[1] + sum[2] * sum[2]);
+				next = none;
+				bool best_aligned = false;
+				int best_shared = 0;
+				float best_alignment = -2.f;
+				size_t best_slot = 0;
+				for (size_t c = 0; c < candidates.size(); ++c)
+				{
+					const std::uint32_t t = candidates[c];
+					int shared = 0;
+					for (size_t j = 0; j < 3; ++j)
+					{
+						if (vertex_of[indices_[t * 3 + j][0]] == id) ++shared;
+					}
+					const std::array<float, 3>& n = normals[t];
+					const bool degenerate =
+						n[0] == 0.f && n[1] == 0.f && n[2] == 0.f;
+					const float alignment = (length > 0.f && !degenerate) ?
+						(n[0] * sum[0] + n[1] * sum[1] + n[2] * sum[2]) /
+						length :
+						1.f;
+					const bool aligned = alignment >= min_alignment;
+					if (!aligned && cluster.size() >= min_triangles) continue;
+					if (next == none ||
+						aligned > best_aligned ||
+						(aligned == best_aligned && shared > best_shared) ||
+						(aligned == best_aligned && shared == best_shared &&
+							alignment > best_alignment))
+					{
+						best_aligned = aligned;
+						best_shared = shared;
+						best_alignment = alignment;
+						best_slot = c;
+						next = t;
+					}
+				}
+				if (next != none)
+				{
+					candidates[best_slot] = candidates.back();
+					candidates.pop_back();
+				}
+			}
+			// Keep the previous order inside of the cluster.
+			std::sort(cluster.begin(), cluster.end());
+		}
+
+		// Move the triangles of both index lists and compute the bounds.
+		std::vector<std::array<int, 3>> indices;
+		std::vector<unsigned int> flat_indices;
+		indices.reserve(indices_.size());
+		flat_indices.reserve(flat_indices_.size());
+		clusters_.reserve(members.size());
+		for (const std::vector<std::uint32_t>& cluster : members)
+		{
+			MeshCluster bounds{};
+			bounds.first_triangle =
+				static_cast<std::uint32_t>(indices.size() / 3);
+			bounds.triangle_count = static_cast<std::uint32_t>(cluster.size());
+			bounds.aabb_min.fill(std::numeric_limits<float>::max());
+			bounds.aabb_max.fill(std::numeric_limits<float>::lowest());
+			std::array<float, 3> axis = {};
+			for (const std::uint32_t t : cluster)
+			{
+				for (size_t j = t * 3; j < t * 3 + 3; ++j)
+				{
+					indices.push_back(indices_[j]);
+					if (has_flat) flat_indices.push_back(flat_indices_[j]);
+					const auto& p = positions_[indices_[j][0]];
+					const std::array<float, 3> xyz = { p.x, p.y, p.z };
+					for (size_t k = 0; k < 3; ++k)
+					{
+						bounds.aabb_min[k] =
+							std::min(bounds.aabb_min[k], xyz[k]);
+						bounds.aabb_max[k] =
+							std::max(bounds.aabb_max[k], xyz[k]);
+					}
+				}
+				for (size_t k = 0; k < 3; ++k) axis[k] += normals[t][k];
+			}
+			for (size_t k = 0; k < 3; ++k)
+			{
+				bounds.center[k] =
+					(bounds.aabb_min[k] + bounds.aabb_max[k]) * .5f;
+			}
+			float radius_squared = 0.f;
+			for (const std::uint32_t t : cluster)
+			{
+				for (size_t j = 0; j < 3; ++j)
+				{
+					const auto& p = position(t, j);
+					const float dx = p.x - bounds.center[0];
+					const float dy = p.y - bounds.center[1];
+					const float dz = p.z - bounds.center[2];
+					radius_squared = std::max(
+						radius_squared,
+						dx * dx + dy * dy + dz * dz);
+				}
+			}
+			bounds.radius = std::sqrt(radius_squared);
+			// Cone around the mean normal, wide enough for all of them.
+			const float length = std::sqrt(
+				axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+			bounds.cone_cutoff = 1.f;
+			if (length > 0.f)
+			{
+				for (float& c : axis) c /= length;
+				float min_dot = 1.f;
+				for (const std::uint32_t t : cluster)
+				{
+					const std::array<float, 3>& n = normals[t];
+					if (n[0] == 0.f && n[1] == 0.f && n[2] == 0.f) continue;
+					min_dot = std::min(
+						min_dot,
+						n[0] * axis[0] + n[1] * axis[1] + n[2] * axis[2]);
+				}
+				if (min_dot > 0.f)
+				{
+					bounds.cone_cutoff = std::sqrt(1.f - min_dot * min_dot);
+				}
+			}
+			bounds.cone_axis = axis;
+			clusters_.push_back(bounds);
+		}
+		indices_ = std::move(indices);
+		if (has_flat) flat_indices_ = std::move(flat_indices);
 	}
 
 	const std::vector<float>& Mesh::GetFlatPositions() const
@@ -185,30 +1281,12 @@ namespace SoftwareGL {
 
 	void Mesh::AllPositionMatrixMult(const VectorMath::matrix& matrix)
 	{
-		std::for_each(
-#if defined(_WIN32) | defined(_WIN64)
-			std::execution::par,
-#endif
-			positions_.begin(), 
-			positions_.end(), 
-			[&matrix](VectorMath::vector4& vec) 
-		{
-			vec = VectorMath::VectorMult(vec, matrix);
-		});
+		AllMatrixMult(positions_, matrix);
 	}
 
 	void Mesh::AllNormalMatrixMult(const VectorMath::matrix& matrix)
 	{
-		std::for_each(
-#if defined(_WIN32) | defined(_WIN64)
-			std::execution::par,
-#endif
-			normals_.begin(),
-			normals_.end(),
-			[&matrix](VectorMath::vector4& vec)
-		{
-			vec = VectorMath::VectorMult(vec, matrix);
-		});
+		AllMatrixMult(normals_, matrix);
 	}
 
 	void Mesh::AllPositionDivideByW()
@@ -310,9 +1388,9 @@ namespace SoftwareGL {
 
 	bool Mesh::ConstIterator::operator!=(const ConstIterator& it) const
 	{
-		if (position_ != it.position_) return true;
-		if (mesh_ != it.mesh_) return true;
-		return false;
+		// Iterators of different meshes are never compared.
+		assert(&mesh_ == &it.mesh_);
+		return position_ != it.position_;
 	}
 
 	void Mesh::ConstIterator::SetLocalTriangle()
@@ -322,28 +1400,30 @@ namespace SoftwareGL {
 		{
 			return;
 		}
-		auto i0 = mesh_.GetIndices()[position_];
-		auto i1 = mesh_.GetIndices()[position_ + 1];
-		auto i2 = mesh_.GetIndices()[position_ + 2];
+		triangle_ = mesh_.GetTriangle(position_ / 3).ToTriangle();
+	}
+
+	Triangle Mesh::IndexedTriangle::ToTriangle() const
+	{
 		Vertex v1;
 		Vertex v2;
 		Vertex v3;
-		v1.SetPosition(mesh_.GetPositions()[i0[0]]);
-		v2.SetPosition(mesh_.GetPositions()[i1[0]]);
-		v3.SetPosition(mesh_.GetPositions()[i2[0]]);
-		if ((i0[1] != -1) && (i1[1] != -1) && (i2[1] != -1))
+		v1.SetPosition(GetPosition(0));
+		v2.SetPosition(GetPosition(1));
+		v3.SetPosition(GetPosition(2));
+		if (HasTexture())
 		{
-			v1.SetTexture(mesh_.GetTextures()[i0[1]]);
-			v2.SetTexture(mesh_.GetTextures()[i1[1]]);
-			v3.SetTexture(mesh_.GetTextures()[i2[1]]);
+			v1.SetTexture(GetTexture(0));
+			v2.SetTexture(GetTexture(1));
+			v3.SetTexture(GetTexture(2));
 		}
-		if ((i0[2] != -1) && (i1[2] != -1) && (i2[2] != -1))
+		if (HasNormal())
 		{
-			v1.SetNormal(mesh_.GetNormals()[i0[2]]);
-			v2.SetNormal(mesh_.GetNormals()[i1[2]]);
-			v3.SetNormal(mesh_.GetNormals()[i2[2]]);
+			v1.SetNormal(GetNormal(0));
+			v2.SetNormal(GetNormal(1));
+			v3.SetNormal(GetNormal(2));
 		}
-		triangle_ = std::make_unique<Triangle>(v1, v2, v3);
+		return Triangle(v1, v2, v3);
 	}
 
 	bool Mesh::operator!=(const Mesh& mesh) const
@@ -3,25 +3,72 @@
 #include <string>
 #include <vector>
 #include <array>
+#include <memory>
+#include "../software_gl/Frustum.h"
+#include "../software_gl/MeshCluster.h"
 #include "../software_gl/Vertex.h"
 #include "../software_gl/Triangle.h"
 
 namespace SoftwareGL {
 
+	class MeshFile;
+
 	class Mesh {
 	public:
 		Mesh() = default;
+		Mesh(
+			std::vector<VectorMath::vector4> positions,
+			std::vector<VectorMath::vector4> normals,
+			std::vector<VectorMath::vector3> textures,
+			std::vector<std::array<int, 3>> indices) :
+			positions_(std::move(positions)),
+			normals_(std::move(normals)),
+			textures_(std::move(textures)),
+			indices_(std::move(indices))
+		{
+			ComputeBounds();
+		}
 		Mesh(const Mesh& mesh) = default;
 		Mesh& operator=(const Mesh& mesh) = default;
+		Mesh(Mesh&& mesh) = default;
+		Mesh& operator=(Mesh&& mesh) = default;
 
 	public:
+		// Map the file and parse it in place.
 		bool LoadFromObj(const std::string& path);
+		bool LoadFromObj(const char* data, const size_t size);
+		// Line by line stream parser, kept to compare load times.
+		bool LoadFromObjStream(const std::string& path);
+		// Copy the arrays out of a binary mesh file (.sglm), the flat ones
+		// only if with_flat is set.
+		bool LoadFromMeshFile(const std::string& path);
+		bool LoadFromMeshFile(const MeshFile& file, const bool with_flat);
 		const std::vector<VectorMath::vector4>& GetPositions() const;
 		const std::vector<VectorMath::vector4>& GetNormals() const;
 		const std::vector<VectorMath::vector3>& GetTextures() const;
 		const std::vector<std::array<int, 3>>& GetIndices() const;
-		// Compute the coordinates to be compatible with OpenGL.
-		void ComputeFlat();
+		// Compute the coordinates to be compatible with OpenGL, corners are
+		// welded into one vertex when all their attributes match (exactly,
+		// or once snapped to a grid of tolerance when it is not 0).
+		void ComputeFlat(const float tolerance = 0.f);
+		// Reorder the triangles for the post-transform vertex cache and
+		// for less overdraw, then the vertices in the order they are used.
+		// The flat buffers follow if they were computed.
+		// Drop the clusters, build them again after.
+		void Optimize();
+		// Group the triangles in clusters of at most max_triangles that
+		// share vertices and face about the same way, the triangles of a
+		// cluster are moved together (in their previous order, so most of
+		// the vertex cache order is kept).
+		void BuildClusters(const size_t max_triangles = 128);
+		const std::vector<MeshCluster>& GetClusters() const
+		{
+			return clusters_;
+		}
+		// Bounds of the positions, kept up to date by the loaders (the
+		// transformations below don't touch them).
+		const BoundingVolume& GetBounds() const { return bounds_; }
+		void ComputeBounds();
 		const std::vector<float>& GetFlatPositions() const;
 		const std::vector<float>& GetFlatNormals() const;
 		const std::vector<float>& GetFlatTextures() const;
@@ -41,10 +88,66 @@ namespace SoftwareGL {
 		void AllPositionMult(const VectorMath::vector4& v);
 
 	public:
+		// Triangle of the mesh seen through its indices, the attributes are
+		// references into the mesh arrays. Cheap to copy (two pointers) and
+		// safe to use from several threads at once.
+		class IndexedTriangle {
+		public:
+			IndexedTriangle(const Mesh& mesh, size_t triangle) :
+				mesh_(&mesh), indices_(&mesh.indices_[triangle * 3]) {}
+
+		public:
+			// Index of position, texture and normal of a corner (0 to 2).
+			const std::array<int, 3>& GetIndices(int corner) const
+			{
+				return indices_[corner];
+			}
+			const VectorMath::vector4& GetPosition(int corner) const
+			{
+				return mesh_->positions_[indices_[corner][0]];
+			}
+			bool HasTexture() const
+			{
+				return
+					indices_[0][1] != -1 &&
+					indices_[1][1] != -1 &&
+					indices_[2][1] != -1;
+			}
+			const VectorMath::vector3& GetTexture(int corner) const
+			{
+				return mesh_->textures_[indices_[corner][1]];
+			}
+			bool HasNormal() const
+			{
+				return
+					indices_[0][2] != -1 &&
+					indices_[1][2] != -1 &&
+					indices_[2][2] != -1;
+			}
+			const VectorMath::vector4& GetNormal(int corner) const
+			{
+				return mesh_->normals_[indices_[corner][2]];
+			}
+			// Assemble a full Triangle (on the stack) with its setup.
+			Triangle ToTriangle() const;
+
+		private:
+			const Mesh* mesh_;
+			const std::array<int, 3>* indices_;
+		};
+		size_t GetTriangleCount() const { return indices_.size() / 3; }
+		IndexedTriangle GetTriangle(size_t triangle) const
+		{
+			return { *this, triangle };
+		}
+
+	public:
+		// Walk the triangles assembled, for loops that need the setup of the
+		// rasterizer. The current Triangle is held by value.
 		class ConstIterator {
 		public:
 			ConstIterator(int position, const Mesh& mesh);
-			const Triangle& operator*() const { return *triangle_; }
+			const Triangle& operator*() const { return triangle_; }
 			ConstIterator& operator++();
 			bool operator!=(const ConstIterator& it) const;
 		
@@ -52,7 +155,7 @@ namespace SoftwareGL {
 			void SetLocalTriangle();
 
 		private:
-			std::unique_ptr<Triangle> triangle_;
+			Triangle triangle_ = {};
 			int position_;
 			const Mesh& mesh_;
 		};
@@ -63,6 +166,11 @@ namespace SoftwareGL {
 			return { static_cast<int>(this->indices_.size()), *this };
 		}
 
+	protected:
+		// Empty every array (they keep their capacity) and the bounds,
+		// before a load and after a failed one.
+		void Clear();
+
 	private:
 		std::vector<VectorMath::vector4> positions_ = {};
 		std::vector<VectorMath::vector4> normals_ = {};
@@ -74,6 +182,11 @@ namespace SoftwareGL {
 		std::vector<float> flat_normals_ = {};
 		std::vector<float> flat_textures_ = {};
 		std::vector<unsigned int> flat_indices_ = {};
+
+	private:
+		// Bounds are in model space, the transformations don't touch them.
+		std::vector<MeshCluster> clusters_ = {};
+		BoundingVolume bounds_ = {};
 	};
 
 }	// End namespace SoftwareGL.
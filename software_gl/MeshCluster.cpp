@@ -0,0 +1,60 @@
+#include "MeshCluster.h"
+
+#include <cmath>
+
+namespace SoftwareGL {
+
+	bool MeshCluster::IsBackFacing(
+		const VectorMath::vector& camera_position) const
+	{
+		const float dx = center[0] - camera_position.x;
+		const float dy = center[1] - camera_position.y;
+		const float dz = center[2] - camera_position.z;
+		const float distance = std::sqrt(dx * dx + dy * dy + dz * dz);
+		// Conservative for the whole sphere, not only for its center.
+		return
+			dx * cone_axis[0] + dy * cone_axis[1] + dz * cone_axis[2] >=
+			cone_cutoff * distance + radius;
+	}
+
+	bool MeshCluster::IsFrontFacing(
+		const VectorMath::vector& camera_position) const
+	{
+		// Same test with the cone turned around.
+		const float dx = center[0] - camera_position.x;
+		const float dy = center[1] - camera_position.y;
+		const float dz = center[2] - camera_position.z;
+		const float distance = std::sqrt(dx * dx + dy * dy + dz * dz);
+		return
+			-(dx * cone_axis[0] + dy * cone_axis[1] + dz * cone_axis[2]) >=
+			cone_cutoff * distance + radius;
+	}
+
+	bool MeshCluster::IsOutside(
+		const VectorMath::matrix& model_view_projection) const
+	{
+		// Bits of the planes every corner is outside of.
+		unsigned int outside = 0x3f;
+		for (unsigned int i = 0; i < 8; ++i)
+		{
+			const VectorMath::vector corner(
+				(i & 1) ? aabb_max[0] : aabb_min[0],
+				(i & 2) ? aabb_max[1] : aabb_min[1],
+				(i & 4) ? aabb_max[2] : aabb_min[2],
+				1.f);
+			const VectorMath::vector clip =
+				VectorMath::VectorMult(corner, model_view_projection);
+			unsigned int bits = 0;
+			if (clip.x < -clip.w) bits |= 0x01;
+			if (clip.x > clip.w) bits |= 0x02;
+			if (clip.y < -clip.w) bits |= 0x04;
+			if (clip.y > clip.w) bits |= 0x08;
+			if (clip.z < 0.f) bits |= 0x10;
+			if (clip.z > clip.w) bits |= 0x20;
+			outside &= bits;
+			if (!outside) return false;
+		}
+		return true;
+	}
+
+}	// End namespace SoftwareGL.
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include "VectorMath.h"
+
+namespace SoftwareGL {
+
+	// Run of neighbouring triangles of a Mesh (see Mesh::BuildClusters) with
+	// the bounds needed to reject it as a whole. Everything is in the model
+	// space of the mesh. Plain data, it is stored as is in a MeshFile.
+	struct MeshCluster
+	{
+		std::uint32_t first_triangle;
+		std::uint32_t triangle_count;
+		// Bounding sphere.
+		std::array<float, 3> center;
+		float radius;
+		// Bounding box.
+		std::array<float, 3> aabb_min;
+		std::array<float, 3> aabb_max;
+		// Cone holding every face normal, cone_cutoff is the sine of its
+		// half angle or 1 when the normals spread over more than a half
+		// sphere (the cluster can't be back facing).
+		std::array<float, 3> cone_axis;
+		float cone_cutoff;
+
+		// No triangle can face a camera at this (model space) position.
+		bool IsBackFacing(const VectorMath::vector& camera_position) const;
+		// Every triangle faces a camera at this position (the mirror of
+		// IsBackFacing).
+		bool IsFrontFacing(const VectorMath::vector& camera_position) const;
+		// The box is completely outside of one of the clip planes (see
+		// VectorMath::Projection), a point is inside when -w <= x, y <= w
+		// and 0 <= z <= w.
+		bool IsOutside(const VectorMath::matrix& model_view_projection) const;
+	};
+
+}	// End namespace SoftwareGL.
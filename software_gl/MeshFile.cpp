@@ -0,0 +1,233 @@
+#include "MeshFile.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <system_error>
+
+namespace SoftwareGL {
+
+	namespace {
+
+		// Order of the arrays in the file.
+		enum mesh_file_array_id : size_t
+		{
+			POSITIONS = 0,
+			NORMALS,
+			TEXTURES,
+			INDICES,
+			FLAT_POSITIONS,
+			FLAT_NORMALS,
+			FLAT_TEXTURES,
+			FLAT_INDICES,
+			CLUSTERS,
+			ARRAY_COUNT
+		};
+
+		struct mesh_file_array
+		{
+			std::uint64_t offset;
+			std::uint64_t count;
+			// Size of an element, guard against a different layout.
+			std::uint64_t element_size;
+		};
+
+		struct mesh_file_header
+		{
+			std::uint32_t magic;
+			std::uint32_t version;
+			std::uint64_t source_size;
+			std::int64_t source_time;
+			std::uint64_t source_hash;
+			mesh_file_array arrays[ARRAY_COUNT];
+		};
+
+		struct mesh_file_data
+		{
+			const void* data;
+			size_t count;
+			size_t element_size;
+		};
+
+		template <typename T>
+		mesh_file_data MakeData(const std::vector<T>& vec)
+		{
+			return { vec.data(), vec.size(), sizeof(T) };
+		}
+
+		size_t AlignUp(size_t value)
+		{
+			return (value + MeshFile::alignment - 1) &
+				~(MeshFile::alignment - 1);
+		}
+
+		template <typename T>
+		bool MakeView(
+			const MappedFile& file,
+			const mesh_file_array& array,
+			BufferView<T>& view)
+		{
+			if (array.element_size != sizeof(T)) return false;
+			if (array.offset % MeshFile::alignment != 0) return false;
+			if (array.count > file.GetSize() / sizeof(T)) return false;
+			if (array.offset + array.count * sizeof(T) > file.GetSize())
+			{
+				return false;
+			}
+			// Point straight into the mapping.
+			view = BufferView<T>(
+				reinterpret_cast<const T*>(file.GetData() + array.offset),
+				static_cast<size_t>(array.count));
+			return true;
+		}
+
+		// Every index points into its array and every cluster into the
+		// triangles, a file that passes can't make a draw read out of bounds.
+		bool HasValidRanges(const MeshFile& file)
+		{
+			const auto indices = file.GetIndices();
+			if (indices.size() % 3 != 0) return false;
+			const auto count = [](const auto& view)
+			{
+				return static_cast<int>(view.size());
+			};
+			const int position_count = count(file.GetPositions());
+			const int texture_count = count(file.GetTextures());
+			const int normal_count = count(file.GetNormals());
+			for (const auto& vi : indices)
+			{
+				if (vi[0] < 0 || vi[0] >= position_count ||
+					vi[1] < -1 || vi[1] >= texture_count ||
+					vi[2] < -1 || vi[2] >= normal_count)
+				{
+					return false;
+				}
+			}
+			if (file.HasFlat())
+			{
+				const size_t vertex_count = file.GetFlatPositions().size() / 3;
+				if (file.GetFlatPositions().size() != vertex_count * 3 ||
+					file.GetFlatNormals().size() != vertex_count * 3 ||
+					file.GetFlatTextures().size() != vertex_count * 2)
+				{
+					return false;
+				}
+				for (const unsigned int index : file.GetFlatIndices())
+				{
+					if (index >= vertex_count) return false;
+				}
+			}
+			const std::uint64_t triangle_count = indices.size() / 3;
+			for (const MeshCluster& cluster : file.GetClusters())
+			{
+				if (static_cast<std::uint64_t>(cluster.first_triangle) +
+					cluster.triangle_count > triangle_count)
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+	}	// End anonymous namespace.
+
+	bool MeshFile::StatSource(const std::string& path, Source& source)
+	{
+		std::error_code error;
+		const auto size = std::filesystem::file_size(path, error);
+		if (error) return false;
+		const auto time = std::filesystem::last_write_time(path, error);
+		if (error) return false;
+		source.size = static_cast<std::uint64_t>(size);
+		source.time =
+			static_cast<std::int64_t>(time.time_since_epoch().count());
+		source.hash = 0;
+		return true;
+	}
+
+	bool MeshFile::Write(
+		const Mesh& mesh,
+		const std::string& path,
+		const Source& source)
+	{
+		const mesh_file_data arrays[ARRAY_COUNT] = {
+			MakeData(mesh.GetPositions()),
+			MakeData(mesh.GetNormals()),
+			MakeData(mesh.GetTextures()),
+			MakeData(mesh.GetIndices()),
+			MakeData(mesh.GetFlatPositions()),
+			MakeData(mesh.GetFlatNormals()),
+			MakeData(mesh.GetFlatTextures()),
+			MakeData(mesh.GetFlatIndices()),
+			MakeData(mesh.GetClusters()) };
+		mesh_file_header header{};
+		header.magic = magic;
+		header.version = version;
+		header.source_size = source.size;
+		header.source_time = source.time;
+		header.source_hash = source.hash;
+		size_t offset = AlignUp(sizeof(header));
+		for (size_t i = 0; i < ARRAY_COUNT; ++i)
+		{
+			header.arrays[i].offset = offset;
+			header.arrays[i].count = arrays[i].count;
+			header.arrays[i].element_size = arrays[i].element_size;
+			offset = AlignUp(offset + arrays[i].count * arrays[i].element_size);
+		}
+		const std::string temporary = path + ".tmp";
+		{
+			std::ofstream ofs(temporary, std::ios::binary);
+			if (!ofs.is_open()) return false;
+			ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			const char padding[alignment] = {};
+			size_t written = sizeof(header);
+			for (size_t i = 0; i < ARRAY_COUNT; ++i)
+			{
+				const size_t bytes = arrays[i].count * arrays[i].element_size;
+				ofs.write(padding, header.arrays[i].offset - written);
+				ofs.write(static_cast<const char*>(arrays[i].data), bytes);
+				written = header.arrays[i].offset + bytes;
+			}
+			if (!ofs.good()) return false;
+		}
+		std::error_code error;
+		std::filesystem::rename(temporary, path, error);
+		if (error)
+		{
+			std::filesystem::remove(temporary, error);
+			return false;
+		}
+		return true;
+	}
+
+	bool MeshFile::Open(const std::string& path)
+	{
+		*this = {};
+		if (!file_.Open(path)) return false;
+		mesh_file_header header;
+		if (file_.GetSize() < sizeof(header)) return false;
+		std::memcpy(&header, file_.GetData(), sizeof(header));
+		if (header.magic != magic) return false;
+		if (header.version != version) return false;
+		const bool ok =
+			MakeView(file_, header.arrays[POSITIONS], positions_) &&
+			MakeView(file_, header.arrays[NORMALS], normals_) &&
+			MakeView(file_, header.arrays[TEXTURES], textures_) &&
+			MakeView(file_, header.arrays[INDICES], indices_) &&
+			MakeView(file_, header.arrays[FLAT_POSITIONS], flat_positions_) &&
+			MakeView(file_, header.arrays[FLAT_NORMALS], flat_normals_) &&
+			MakeView(file_, header.arrays[FLAT_TEXTURES], flat_textures_) &&
+			MakeView(file_, header.arrays[FLAT_INDICES], flat_indices_) &&
+			MakeView(file_, header.arrays[CLUSTERS], clusters_);
+		if (!ok || !HasValidRanges(*this))
+		{
+			*this = {};
+			return false;
+		}
+		source_.size = header.source_size;
+		source_.time = header.source_time;
+		source_.hash = header.source_hash;
+		return true;
+	}
+
+}	// End namespace SoftwareGL.
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include "BufferView.h"
+#include "MappedFile.h"
+#include "Mesh.h"
+#include "MeshCluster.h"
+#include "VectorMath.h"
+
+namespace SoftwareGL {
+
+	// Binary mesh container (.sglm) holding the arrays of a Mesh (and its
+	// flat OpenGL buffers and clusters when they were computed) in their
+	// in-memory layout. Opening one maps it and hands out views into the
+	// mapping, so nothing is parsed or copied. When used as a cache next to an OBJ the
+	// header records the size, time and content hash of the source.
+	class MeshFile
+	{
+	public:
+		static constexpr std::uint32_t magic = 0x4d4c4753;	// "SGLM"
+		// Version 2, meshes are stored optimized (see Mesh::Optimize).
+		// Version 3, with their clusters (see Mesh::BuildClusters).
+		static constexpr std::uint32_t version = 3;
+		static constexpr size_t alignment = 64;
+		// Sidecar of an OBJ is the OBJ path with this appended.
+		static constexpr const char* extension = ".sglm";
+
+	public:
+		struct Source
+		{
+			std::uint64_t size = 0;
+			std::int64_t time = 0;
+			std::uint64_t hash = 0;
+		};
+		// Size and modification time of a file (the hash is left to 0).
+		static bool StatSource(const std::string& path, Source& source);
+		// Write through a temporary file so that a reader never sees a
+		// partial file.
+		static bool Write(
+			const Mesh& mesh,
+			const std::string& path,
+			const Source& source);
+
+	public:
+		bool Open(const std::string& path);
+		const Source& GetSource() const { return source_; }
+		bool HasFlat() const { return !flat_indices_.empty(); }
+		BufferView<VectorMath::vector4> GetPositions() const
+		{
+			return positions_;
+		}
+		BufferView<VectorMath::vector4> GetNormals() const
+		{
+			return normals_;
+		}
+		BufferView<VectorMath::vector3> GetTextures() const
+		{
+			return textures_;
+		}
+		BufferView<std::array<int, 3>> GetIndices() const
+		{
+			return indices_;
+		}
+		BufferView<float> GetFlatPositions() const { return flat_positions_; }
+		BufferView<float> GetFlatNormals() const { return flat_normals_; }
+		BufferView<float> GetFlatTextures() const { return flat_textures_; }
+		BufferView<unsigned int> GetFlatIndices() const
+		{
+			return flat_indices_;
+		}
+		BufferView<MeshCluster> GetClusters() const { return clusters_; }
+
+	private:
+		MappedFile file_;
+		Source source_ = {};
+		BufferView<VectorMath::vector4> positions_ = {};
+		BufferView<VectorMath::vector4> normals_ = {};
+		BufferView<VectorMath::vector3> textures_ = {};
+		BufferView<std::array<int, 3>> indices_ = {};
+		BufferView<float> flat_positions_ = {};
+		BufferView<float> flat_normals_ = {};
+		BufferView<float> flat_textures_ = {};
+		BufferView<unsigned int> flat_indices_ = {};
+		BufferView<MeshCluster> clusters_ = {};
+	};
+
+}	// End namespace SoftwareGL.
@@ -0,0 +1,45 @@
+#include "MeshLod.h"
+
+#include <algorithm>
+#include <assert.h>
+#include "MeshSimplifier.h"
+
+namespace SoftwareGL {
+
+	MeshLod::MeshLod(
+		std::shared_ptr<const Mesh> mesh,
+		const float ratio /*= .5f*/,
+		const size_t min_triangles /*= 64*/,
+		const size_t max_levels /*= 8*/)
+	{
+		assert(mesh);
+		assert(ratio > 0.f && ratio < 1.f);
+		levels_.push_back({ mesh, 0.f });
+		const bool has_flat = !mesh->GetFlatIndices().empty();
+		const bool has_clusters = !mesh->GetClusters().empty();
+		// Every level goes on from the previous one, the error is the
+		// largest one since the original.
+		MeshSimplifier simplifier(*mesh);
+		while (levels_.size() < max_levels)
+		{
+			const size_t previous = simplifier.GetTriangleCount();
+			if (previous <= min_triangles) break;
+			const size_t target = std::max(
+				min_triangles,
+				static_cast<size_t>(previous * ratio));
+			simplifier.Simplify(target);
+			// Stuck on seams and borders, not worth another level.
+			const size_t removed = previous - simplifier.GetTriangleCount();
+			if (removed < static_cast<size_t>(previous * (1.f - ratio) * .5f))
+			{
+				break;
+			}
+			auto level = std::make_shared<Mesh>(simplifier.GetMesh());
+			if (has_flat) level->ComputeFlat();
+			level->Optimize();
+			if (has_clusters) level->BuildClusters();
+			levels_.push_back({ level, simplifier.GetError() });
+		}
+	}
+
+}	// End namespace SoftwareGL.
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include "Mesh.h"
+#include "VectorMath.h"
+
+namespace SoftwareGL {
+
+	// Chain of simplified versions of a mesh (see MeshSimplifier), level 0
+	// is the mesh itself and every level has about half the triangles of
+	// the previous one. The error of a level is the distance (in the units
+	// of the mesh) it may be off the original surface, the renderer turns
+	// it into pixels to pick one (see Renderer::SelectLod).
+	class MeshLod
+	{
+	public:
+		struct Level
+		{
+			std::shared_ptr<const Mesh> mesh;
+			float error;
+		};
+
+	public:
+		MeshLod() = default;
+		// Levels stop at min_triangles, after max_levels or when the
+		// simplification can't remove ratio of the triangles anymore. They
+		// are optimized and get the flat buffers and the clusters when the
+		// mesh has them.
+		explicit MeshLod(
+			std::shared_ptr<const Mesh> mesh,
+			const float ratio = .5f,
+			const size_t min_triangles = 64,
+			const size_t max_levels = 8);
+
+	public:
+		bool empty() const { return levels_.empty(); }
+		size_t GetLevelCount() const { return levels_.size(); }
+		const Level& GetLevel(const size_t level) const
+		{
+			return levels_[level];
+		}
+		// Bounds of the mesh (level 0), in model space.
+		const BoundingVolume& GetBounds() const
+		{
+			return levels_.front().mesh->GetBounds();
+		}
+
+	private:
+		std::vector<Level> levels_ = {};
+	};
+
+}	// End namespace SoftwareGL.
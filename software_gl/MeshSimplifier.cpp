@@ -0,0 +1,477 @@
+#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <unordered_map>
+#include <assert.h>
+
+namespace SoftwareGL {
+
+	namespace {
+
+		// Twice the area oriented normal of a triangle.
+		std::array<double, 3> FaceNormal(
+			const VectorMath::vector4& p0,
+			const VectorMath::vector4& p1,
+			const VectorMath::vector4& p2)
+		{
+			const std::array<double, 3> e1 =
+				{ p1.x - p0.x, p1.y - p0.y, p1.z - p0.z };
+			const std::array<double, 3> e2 =
+				{ p2.x - p0.x, p2.y - p0.y, p2.z - p0.z };
+			return {
+				e1[1] * e2[2] - e1[2] * e2[1],
+				e1[2] * e2[0] - e1[0] * e2[2],
+				e1[0] * e2[1] - e1[1] * e2[0] };
+		}
+
+		double Dot(
+			const std::array<double, 3>& a,
+			const std::array<double, 3>& b)
+		{
+			return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+		}
+
+		bool SameTexture(const Mesh& mesh, int a, int b)
+		{
+			if (a == b) return true;
+			if (a < 0 || b < 0) return false;
+			const VectorMath::vector3& ta = mesh.GetTextures()[a];
+			const VectorMath::vector3& tb = mesh.GetTextures()[b];
+			return ta.x == tb.x && ta.y == tb.y;
+		}
+
+		bool SameNormal(const Mesh& mesh, int a, int b)
+		{
+			if (a == b) return true;
+			if (a < 0 || b < 0) return false;
+			const VectorMath::vector4& na = mesh.GetNormals()[a];
+			const VectorMath::vector4& nb = mesh.GetNormals()[b];
+			return na.x == nb.x && na.y == nb.y && na.z == nb.z;
+		}
+
+	}	// End anonymous namespace.
+
+	MeshSimplifier::MeshSimplifier(const Mesh& mesh) :
+		mesh_(mesh),
+		corners_(mesh.GetIndices())
+	{
+		const size_t vertex_count = mesh_.GetPositions().size();
+		const size_t triangle_count = corners_.size() / 3;
+		dead_.assign(triangle_count, 0);
+		vertex_triangles_.resize(vertex_count);
+		locked_.assign(vertex_count, 0);
+		stamps_.assign(vertex_count, 0);
+		quadrics_.assign(vertex_count, {});
+		weights_.assign(vertex_count, 0.0);
+		// One normal per face, they are made again from the positions.
+		flat_normals_ = triangle_count > 0;
+		for (size_t t = 0; t < triangle_count && flat_normals_; ++t)
+		{
+			flat_normals_ =
+				corners_[t * 3][2] >= 0 &&
+				corners_[t * 3][2] == corners_[t * 3 + 1][2] &&
+				corners_[t * 3][2] == corners_[t * 3 + 2][2];
+		}
+
+		std::unordered_map<std::uint64_t, std::uint32_t> edges;
+		const auto& positions = mesh_.GetPositions();
+		for (size_t t = 0; t < triangle_count; ++t)
+		{
+			const int a = corners_[t * 3][0];
+			const int b = corners_[t * 3 + 1][0];
+			const int c = corners_[t * 3 + 2][0];
+			if (a == b || b == c || c == a)
+			{
+				dead_[t] = 1;
+				continue;
+			}
+			++triangle_count_;
+			// Plane of the face weighted by its area.
+			const std::array<double, 3> n =
+				FaceNormal(positions[a], positions[b], positions[c]);
+			const double length = std::sqrt(Dot(n, n));
+			const double area = length * .5;
+			Quadric q = {};
+			if (length > 0.0)
+			{
+				const double nx = n[0] / length;
+				const double ny = n[1] / length;
+				const double nz = n[2] / length;
+				const double d = -(
+					nx * positions[a].x +
+					ny * positions[a].y +
+					nz * positions[a].z);
+				q = {
+					nx * nx, nx * ny, nx * nz, nx * d,
+					ny * ny, ny * nz, ny * d,
+					nz * nz, nz * d,
+					d * d };
+			}
+			for (size_t j = 0; j < 3; ++j)
+			{
+				const int v = corners_[t * 3 + j][0];
+				vertex_triangles_[v].push_back(static_cast<std::uint32_t>(t));
+				for (size_t k = 0; k < q.size(); ++k)
+				{
+					quadrics_[v][k] += q[k] * area;
+				}
+				weights_[v] += area;
+				const int w = corners_[t * 3 + (j + 1) % 3][0];
+				const std::uint64_t key =
+					(static_cast<std::uint64_t>(std::min(v, w)) << 32) |
+					static_cast<std::uint64_t>(std::max(v, w));
+				++edges[key];
+			}
+		}
+		// Borders and non manifold edges.
+		for (const auto& edge : edges)
+		{
+			if (edge.second == 2) continue;
+			locked_[edge.first >> 32] = 1;
+			locked_[edge.first & 0xffffffff] = 1;
+		}
+		// Seams, corners of a vertex with different attributes.
+		std::vector<int> first_corner(vertex_count, -1);
+		for (size_t i = 0; i < corners_.size(); ++i)
+		{
+			if (dead_[i / 3]) continue;
+			const std::array<int, 3>& corner = corners_[i];
+			int& first = first_corner[corner[0]];
+			if (first < 0)
+			{
+				first = static_cast<int>(i);
+				continue;
+			}
+			const std::array<int, 3>& other = corners_[first];
+			if (!SameTexture(mesh_, corner[1], other[1]) ||
+				(!flat_normals_ && !SameNormal(mesh_, corner[2], other[2])))
+			{
+				locked_[corner[0]] = 1;
+			}
+		}
+
+		std::vector<std::uint32_t> neighbours;
+		for (std::uint32_t v = 0; v < vertex_count; ++v)
+		{
+			if (locked_[v]) continue;
+			GatherNeighbours(v, neighbours);
+			for (const std::uint32_t n : neighbours)
+			{
+				heap_.push_back(MakeCollapse(v, n));
+			}
+		}
+		std::make_heap(heap_.begin(), heap_.end(), std::greater<>());
+	}
+
+	void MeshSimplifier::Simplify(const size_t target_triangles)
+	{
+		while (triangle_count_ > target_triangles && !heap_.empty())
+		{
+			std::pop_heap(heap_.begin(), heap_.end(), std::greater<>());
+			const Collapse collapse = heap_.back();
+			heap_.pop_back();
+			// Stale, one of the two vertices changed since.
+			if (collapse.from_stamp != stamps_[collapse.from] ||
+				collapse.to_stamp != stamps_[collapse.to])
+			{
+				continue;
+			}
+			if (locked_[collapse.from]) continue;
+			if (!IsValid(collapse.from, collapse.to)) continue;
+			const double weight =
+				weights_[collapse.from] + weights_[collapse.to];
+			if (weight > 0.0)
+			{
+				error_ = std::max(
+					error_,
+					static_cast<float>(
+						std::sqrt(std::max(collapse.cost, 0.0) / weight)));
+			}
+			Apply(collapse.from, collapse.to);
+			PushCollapses(collapse.to);
+		}
+	}
+
+	Mesh MeshSimplifier::GetMesh() const
+	{
+		constexpr int unused = -1;
+		const auto& positions = mesh_.GetPositions();
+		const auto& textures = mesh_.GetTextures();
+		const auto& normals = mesh_.GetNormals();
+		std::vector<int> position_remap(positions.size(), unused);
+		std::vector<int> texture_remap(textures.size(), unused);
+		std::vector<int> normal_remap(normals.size(), unused);
+		std::vector<VectorMath::vector4> new_positions;
+		std::vector<VectorMath::vector4> new_normals;
+		std::vector<VectorMath::vector3> new_textures;
+		std::vector<std::array<int, 3>> new_indices;
+		new_indices.reserve(triangle_count_ * 3);
+		const auto remap = [](
+			int index,
+			std::vector<int>& table,
+			auto& values,
+			const auto& source)
+		{
+			if (index < 0) return -1;
+			if (table[index] == unused)
+			{
+				table[index] = static_cast<int>(values.size());
+				values.push_back(source[index]);
+			}
+			return table[index];
+		};
+		for (size_t t = 0; t < dead_.size(); ++t)
+		{
+			if (dead_[t]) continue;
+			int flat_normal = -1;
+			if (flat_normals_)
+			{
+				const std::array<double, 3> n = FaceNormal(
+					positions[corners_[t * 3][0]],
+					positions[corners_[t * 3 + 1][0]],
+					positions[corners_[t * 3 + 2][0]]);
+				const double length = std::sqrt(Dot(n, n));
+				if (length > 0.0)
+				{
+					flat_normal = static_cast<int>(new_normals.size());
+					new_normals.push_back(VectorMath::vector4(
+						static_cast<float>(n[0] / length),
+						static_cast<float>(n[1] / length),
+						static_cast<float>(n[2] / length),
+						1.f));
+				}
+			}
+			for (size_t i = t * 3; i < t * 3 + 3; ++i)
+			{
+				const std::array<int, 3>& corner = corners_[i];
+				std::array<int, 3> vi;
+				vi[0] = remap(
+					corner[0], position_remap, new_positions, positions);
+				vi[1] = remap(
+					corner[1], texture_remap, new_textures, textures);
+				vi[2] = flat_normal >= 0 ?
+					flat_normal :
+					remap(corner[2], normal_remap, new_normals, normals);
+				new_indices.push_back(vi);
+			}
+		}
+		return Mesh(
+			std::move(new_positions),
+			std::move(new_normals),
+			std::move(new_textures),
+			std::move(new_indices));
+	}
+
+	MeshSimplifier::Collapse MeshSimplifier::MakeCollapse(
+		std::uint32_t from,
+		std::uint32_t to) const
+	{
+		// On flat parts every cost is 0, the length makes the short edges
+		// go first there instead of piling up fans on a single vertex.
+		constexpr double length_factor = 1e-3;
+		const Quadric& a = quadrics_[from];
+		const Quadric& b = quadrics_[to];
+		Quadric q;
+		for (size_t k = 0; k < q.size(); ++k) q[k] = a[k] + b[k];
+		const VectorMath::vector4& p = mesh_.GetPositions()[to];
+		const VectorMath::vector4& o = mesh_.GetPositions()[from];
+		const double x = p.x;
+		const double y = p.y;
+		const double z = p.z;
+		const double cost =
+			q[0] * x * x + 2 * q[1] * x * y + 2 * q[2] * x * z +
+			2 * q[3] * x +
+			q[4] * y * y + 2 * q[5] * y * z + 2 * q[6] * y +
+			q[7] * z * z + 2 * q[8] * z +
+			q[9];
+		const double length_squared =
+			(x - o.x) * (x - o.x) +
+			(y - o.y) * (y - o.y) +
+			(z - o.z) * (z - o.z);
+		const double weight = weights_[from] + weights_[to];
+		return {
+			cost + length_factor * weight * length_squared,
+			cost,
+			from,
+			to,
+			stamps_[from],
+			stamps_[to] };
+	}
+
+	void MeshSimplifier::GatherNeighbours(
+		std::uint32_t vertex,
+		std::vector<std::uint32_t>& neighbours) const
+	{
+		neighbours.clear();
+		for (const std::uint32_t t : vertex_triangles_[vertex])
+		{
+			if (dead_[t]) continue;
+			for (size_t j = t * 3; j < t * 3 + 3; ++j)
+			{
+				const std::uint32_t v =
+					static_cast<std::uint32_t>(corners_[j][0]);
+				if (v == vertex) continue;
+				if (std::find(neighbours.begin(), neighbours.end(), v) ==
+					neighbours.end())
+				{
+					neighbours.push_back(v);
+				}
+			}
+		}
+	}
+
+	bool MeshSimplifier::IsValid(std::uint32_t from, std::uint32_t to) const
+	{
+		const auto& positions = mesh_.GetPositions();
+		// Triangles on the edge, the corner of "to" in them gives the
+		// attributes of the moved corners, they have to agree.
+		size_t shared = 0;
+		int texture = -1;
+		int normal = -1;
+		for (const std::uint32_t t : vertex_triangles_[from])
+		{
+			if (dead_[t]) continue;
+			for (size_t j = t * 3; j < t * 3 + 3; ++j)
+			{
+				if (corners_[j][0] != static_cast<int>(to)) continue;
+				if (shared++ == 0)
+				{
+					texture = corners_[j][1];
+					normal = corners_[j][2];
+				}
+				else if (
+					!SameTexture(mesh_, texture, corners_[j][1]) ||
+					(!flat_normals_ &&
+						!SameNormal(mesh_, normal, corners_[j][2])))
+				{
+					return false;
+				}
+			}
+		}
+		if (shared == 0) return false;
+		// Link condition, the two vertices have no other common neighbour
+		// than the ones of the triangles on the edge (or the mesh would
+		// pinch).
+		std::vector<std::uint32_t> from_neighbours;
+		std::vector<std::uint32_t> to_neighbours;
+		GatherNeighbours(from, from_neighbours);
+		GatherNeighbours(to, to_neighbours);
+		size_t common = 0;
+		for (const std::uint32_t v : from_neighbours)
+		{
+			if (std::find(to_neighbours.begin(), to_neighbours.end(), v) !=
+				to_neighbours.end())
+			{
+				++common;
+			}
+		}
+		if (common != shared) return false;
+		// The triangles that stay must not fold over (or get degenerate).
+		for (const std::uint32_t t : vertex_triangles_[from])
+		{
+			if (dead_[t]) continue;
+			std::array<VectorMath::vector4, 3> before;
+			std::array<VectorMath::vector4, 3> after;
+			bool has_to = false;
+			for (size_t j = 0; j < 3; ++j)
+			{
+				const int v = corners_[t * 3 + j][0];
+				has_to |= v == static_cast<int>(to);
+				before[j] = positions[v];
+				after[j] =
+					v == static_cast<int>(from) ? positions[to] : positions[v];
+			}
+			if (has_to) continue;
+			const std::array<double, 3> n0 =
+				FaceNormal(before[0], before[1], before[2]);
+			const std::array<double, 3> n1 =
+				FaceNormal(after[0], after[1], after[2]);
+			const double l0 = std::sqrt(Dot(n0, n0));
+			const double l1 = std::sqrt(Dot(n1, n1));
+			if (l1 <= 0.0) return false;
+			// More than about 75 degrees.
+			if (Dot(n0, n1) <= .25 * l0 * l1) return false;
+		}
+		return true;
+	}
+
+	void MeshSimplifier::Apply(std::uint32_t from, std::uint32_t to)
+	{
+		int texture = -1;
+		int normal = -1;
+		for (const std::uint32_t t : vertex_triangles_[from])
+		{
+			if (dead_[t]) continue;
+			for (size_t j = t * 3; j < t * 3 + 3; ++j)
+			{
+				if (corners_[j][0] != static_cast<int>(to)) continue;
+				texture = corners_[j][1];
+				normal = corners_[j][2];
+			}
+		}
+		std::vector<std::uint32_t>& to_triangles = vertex_triangles_[to];
+		for (const std::uint32_t t : vertex_triangles_[from])
+		{
+			if (dead_[t]) continue;
+			bool has_to = false;
+			for (size_t j = t * 3; j < t * 3 + 3; ++j)
+			{
+				has_to |= corners_[j][0] == static_cast<int>(to);
+			}
+			if (has_to)
+			{
+				dead_[t] = 1;
+				--triangle_count_;
+				continue;
+			}
+			for (size_t j = t * 3; j < t * 3 + 3; ++j)
+			{
+				std::array<int, 3>& corner = corners_[j];
+				if (corner[0] != static_cast<int>(from)) continue;
+				corner[0] = static_cast<int>(to);
+				corner[1] = texture;
+				// Flat normals belong to the face, they are made again.
+				if (!flat_normals_) corner[2] = normal;
+			}
+			to_triangles.push_back(t);
+		}
+		vertex_triangles_[from].clear();
+		to_triangles.erase(
+			std::remove_if(
+				to_triangles.begin(),
+				to_triangles.end(),
+				[this](std::uint32_t t) { return dead_[t] != 0; }),
+			to_triangles.end());
+		for (size_t k = 0; k < quadrics_[to].size(); ++k)
+		{
+			quadrics_[to][k] += quadrics_[from][k];
+		}
+		weights_[to] += weights_[from];
+		locked_[from] = 1;
+		++stamps_[from];
+		++stamps_[to];
+	}
+
+	void MeshSimplifier::PushCollapses(std::uint32_t vertex)
+	{
+		std::vector<std::uint32_t> neighbours;
+		GatherNeighbours(vertex, neighbours);
+		for (const std::uint32_t n : neighbours)
+		{
+			if (!locked_[vertex])
+			{
+				heap_.push_back(MakeCollapse(vertex, n));
+				std::push_heap(heap_.begin(), heap_.end(), std::greater<>());
+			}
+			if (!locked_[n])
+			{
+				heap_.push_back(MakeCollapse(n, vertex));
+				std::push_heap(heap_.begin(), heap_.end(), std::greater<>());
+			}
+		}
+	}
+
+}	// End namespace SoftwareGL.
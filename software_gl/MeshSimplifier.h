@@ -0,0 +1,79 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+#include "Mesh.h"
+#include "VectorMath.h"
+
+namespace SoftwareGL {
+
+	// Quadric error simplification (Garland and Heckbert, "Surface
+	// Simplification Using Quadric Error Metrics") by half edge collapses:
+	// a vertex is merged into one of its neighbours, so no new position or
+	// attribute is ever made up. Vertices on a border, on a texture seam
+	// or on a normal seam (for smooth meshes) never move, so seams stay
+	// exactly where they were. Meshes with one normal per face get face
+	// normals computed again for the result.
+	class MeshSimplifier
+	{
+	public:
+		// The mesh is referenced, it has to outlive the simplifier.
+		explicit MeshSimplifier(const Mesh& mesh);
+
+	public:
+		// Collapse edges, cheapest first, until the mesh has at most
+		// target_triangles or nothing can be collapsed anymore. Can be
+		// called again with a lower target to continue.
+		void Simplify(const size_t target_triangles);
+		size_t GetTriangleCount() const { return triangle_count_; }
+		// Largest error of a collapse so far, as a distance in the units of
+		// the mesh (weighted root mean square to the original planes).
+		float GetError() const { return error_; }
+		// Compacted copy of the current state.
+		Mesh GetMesh() const;
+
+	protected:
+		// Symmetric 4x4 matrix, upper triangle.
+		using Quadric = std::array<double, 10>;
+		struct Collapse
+		{
+			// Cost with the length of the edge added (see MakeCollapse).
+			double priority;
+			double cost;
+			std::uint32_t from;
+			std::uint32_t to;
+			std::uint32_t from_stamp;
+			std::uint32_t to_stamp;
+			bool operator>(const Collapse& collapse) const
+			{
+				return priority > collapse.priority;
+			}
+		};
+		Collapse MakeCollapse(std::uint32_t from, std::uint32_t to) const;
+		// Every neighbour of a vertex through its live triangles.
+		void GatherNeighbours(
+			std::uint32_t vertex,
+			std::vector<std::uint32_t>& neighbours) const;
+		// Manifold, no fold over and seam attributes that agree.
+		bool IsValid(std::uint32_t from, std::uint32_t to) const;
+		void Apply(std::uint32_t from, std::uint32_t to);
+		void PushCollapses(std::uint32_t vertex);
+
+	private:
+		const Mesh& mesh_;
+		// Corners (position, texture, normal) of the triangles.
+		std::vector<std::array<int, 3>> corners_;
+		std::vector<std::uint8_t> dead_;
+		std::vector<std::vector<std::uint32_t>> vertex_triangles_;
+		std::vector<std::uint8_t> locked_;
+		std::vector<std::uint32_t> stamps_;
+		std::vector<Quadric> quadrics_;
+		std::vector<double> weights_;
+		std::vector<Collapse> heap_ = {};
+		size_t triangle_count_ = 0;
+		float error_ = 0.f;
+		bool flat_normals_ = false;
+	};
+
+}	// End namespace SoftwareGL.
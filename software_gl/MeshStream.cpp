@@ -0,0 +1,302 @@
+#include "MeshStream.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace SoftwareGL {
+
+	namespace {
+
+		struct mesh_stream_header
+		{
+			std::uint32_t magic;
+			std::uint32_t version;
+			std::uint64_t chunk_count;
+			std::uint64_t triangle_count;
+			// Size of the elements, guard against a different layout.
+			std::uint32_t vector4_size;
+			std::uint32_t vector3_size;
+		};
+
+		template <typename T>
+		void WriteArray(std::ofstream& ofs, const std::vector<T>& vec)
+		{
+			ofs.write(
+				reinterpret_cast<const char*>(vec.data()),
+				vec.size() * sizeof(T));
+		}
+
+		template <typename T>
+		bool ReadArray(std::ifstream& ifs, std::vector<T>& vec, size_t count)
+		{
+			vec.resize(count);
+			return static_cast<bool>(ifs.read(
+				reinterpret_cast<char*>(vec.data()),
+				count * sizeof(T)));
+		}
+
+	}	// End anonymous namespace.
+
+	bool MeshStream::Write(
+		const Mesh& mesh,
+		const std::string& path,
+		const size_t triangles_per_chunk /*= 64 * 1024*/)
+	{
+		if (triangles_per_chunk == 0) return false;
+		const size_t triangle_count = mesh.GetTriangleCount();
+		const size_t chunk_count =
+			(triangle_count + triangles_per_chunk - 1) / triangles_per_chunk;
+		mesh_stream_header header{};
+		header.magic = magic;
+		header.version = version;
+		header.chunk_count = chunk_count;
+		header.triangle_count = triangle_count;
+		header.vector4_size = sizeof(VectorMath::vector4);
+		header.vector3_size = sizeof(VectorMath::vector3);
+		std::ofstream ofs(path, std::ios::binary);
+		if (!ofs.is_open()) return false;
+		ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		// Table first, patched once the chunks are written.
+		std::vector<Chunk> chunks(chunk_count);
+		const std::streamoff table_offset = ofs.tellp();
+		WriteArray(ofs, chunks);
+		// Local number of every position, texture and normal, -1 when not
+		// used by the current chunk.
+		const size_t counts[3] = {
+			mesh.GetPositions().size(),
+			mesh.GetTextures().size(),
+			mesh.GetNormals().size() };
+		std::vector<int> locals[3];
+		for (size_t k = 0; k < 3; ++k) locals[k].assign(counts[k], -1);
+		for (size_t c = 0; c < chunk_count; ++c)
+		{
+			const size_t begin = c * triangles_per_chunk;
+			const size_t end =
+				std::min(begin + triangles_per_chunk, triangle_count);
+			std::vector<std::uint32_t> used[3];
+			std::vector<std::array<int, 3>> indices;
+			indices.reserve((end - begin) * 3);
+			for (size_t t = begin; t < end; ++t)
+			{
+				const Mesh::IndexedTriangle triangle = mesh.GetTriangle(t);
+				for (int corner = 0; corner < 3; ++corner)
+				{
+					std::array<int, 3> vi = triangle.GetIndices(corner);
+					for (size_t k = 0; k < 3; ++k)
+					{
+						if (vi[k] < 0) continue;
+						int& local = locals[k][vi[k]];
+						if (local < 0)
+						{
+							local = static_cast<int>(used[k].size());
+							used[k].push_back(vi[k]);
+						}
+						vi[k] = local;
+					}
+					indices.push_back(vi);
+				}
+			}
+			std::vector<VectorMath::vector4> positions;
+			std::vector<VectorMath::vector3> textures;
+			std::vector<VectorMath::vector4> normals;
+			for (const std::uint32_t i : used[0])
+			{
+				positions.push_back(mesh.GetPositions()[i]);
+			}
+			for (const std::uint32_t i : used[1])
+			{
+				textures.push_back(mesh.GetTextures()[i]);
+			}
+			for (const std::uint32_t i : used[2])
+			{
+				normals.push_back(mesh.GetNormals()[i]);
+			}
+			// Reset only what this chunk touched.
+			for (size_t k = 0; k < 3; ++k)
+			{
+				for (const std::uint32_t i : used[k]) locals[k][i] = -1;
+			}
+			Chunk& chunk = chunks[c];
+			chunk.offset = static_cast<std::uint64_t>(ofs.tellp());
+			chunk.position_count = static_cast<std::uint32_t>(positions.size());
+			chunk.normal_count = static_cast<std::uint32_t>(normals.size());
+			chunk.texture_count = static_cast<std::uint32_t>(textures.size());
+			chunk.triangle_count = static_cast<std::uint32_t>(end - begin);
+			WriteArray(ofs, positions);
+			WriteArray(ofs, normals);
+			WriteArray(ofs, textures);
+			WriteArray(ofs, indices);
+		}
+		ofs.seekp(table_offset);
+		WriteArray(ofs, chunks);
+		return ofs.good();
+	}
+
+	MeshStream::~MeshStream()
+	{
+		StopLoader();
+	}
+
+	bool MeshStream::Open(const std::string& path)
+	{
+		StopLoader();
+		chunks_.clear();
+		triangle_count_ = 0;
+		max_chunk_size_ = 0;
+		file_.close();
+		file_.clear();
+		file_.open(path, std::ios::binary);
+		if (!file_.is_open()) return false;
+		mesh_stream_header header{};
+		if (!file_.read(reinterpret_cast<char*>(&header), sizeof(header)))
+		{
+			return false;
+		}
+		if (header.magic != magic) return false;
+		if (header.version != version) return false;
+		if (header.vector4_size != sizeof(VectorMath::vector4)) return false;
+		if (header.vector3_size != sizeof(VectorMath::vector3)) return false;
+		if (header.chunk_count > std::numeric_limits<std::uint32_t>::max())
+		{
+			return false;
+		}
+		if (!ReadArray(file_, chunks_, static_cast<size_t>(header.chunk_count)))
+		{
+			chunks_.clear();
+			return false;
+		}
+		triangle_count_ = static_cast<size_t>(header.triangle_count);
+		for (const Chunk& chunk : chunks_)
+		{
+			max_chunk_size_ = std::max(max_chunk_size_, GetChunkSize(chunk));
+		}
+		// One chunk drawn while the next one is read.
+		if (max_chunk_size_ * 2 > memory_budget_)
+		{
+			chunks_.clear();
+			return false;
+		}
+		stop_ = false;
+		has_request_ = false;
+		has_loaded_ = false;
+		loader_ = std::thread(&MeshStream::LoaderThread, this);
+		return true;
+	}
+
+	bool MeshStream::ForEachChunk(const std::function<void(Mesh&)>& function)
+	{
+		if (chunks_.empty()) return true;
+		Request(0);
+		for (size_t i = 0; i < chunks_.size(); ++i)
+		{
+			Mesh current;
+			{
+				std::unique_lock<std::mutex> lock(mutex_);
+				condition_.wait(lock, [this] { return has_loaded_; });
+				has_loaded_ = false;
+				if (!loaded_ok_) return false;
+				current = std::move(loaded_);
+			}
+			// Read the next chunk while this one is used.
+			if (i + 1 < chunks_.size()) Request(i + 1);
+			function(current);
+		}
+		return true;
+	}
+
+	size_t MeshStream::GetChunkSize(const Chunk& chunk)
+	{
+		return
+			(static_cast<size_t>(chunk.position_count) + chunk.normal_count) *
+				sizeof(VectorMath::vector4) +
+			static_cast<size_t>(chunk.texture_count) *
+				sizeof(VectorMath::vector3) +
+			static_cast<size_t>(chunk.triangle_count) * 3 *
+				sizeof(std::array<int, 3>);
+	}
+
+	bool MeshStream::ReadChunk(const size_t index, Mesh& mesh)
+	{
+		const Chunk& chunk = chunks_[index];
+		std::vector<VectorMath::vector4> positions;
+		std::vector<VectorMath::vector4> normals;
+		std::vector<VectorMath::vector3> textures;
+		std::vector<std::array<int, 3>> indices;
+		file_.clear();
+		file_.seekg(static_cast<std::streamoff>(chunk.offset));
+		if (!ReadArray(file_, positions, chunk.position_count) ||
+			!ReadArray(file_, normals, chunk.normal_count) ||
+			!ReadArray(file_, textures, chunk.texture_count) ||
+			!ReadArray(file_, indices, chunk.triangle_count * size_t(3)))
+		{
+			return false;
+		}
+		// Don't trust the file with the indices.
+		for (const std::array<int, 3>& vi : indices)
+		{
+			if (vi[0] < 0 ||
+				vi[0] >= static_cast<int>(positions.size()) ||
+				vi[1] < -1 ||
+				vi[1] >= static_cast<int>(textures.size()) ||
+				vi[2] < -1 ||
+				vi[2] >= static_cast<int>(normals.size()))
+			{
+				return false;
+			}
+		}
+		mesh = Mesh(
+			std::move(positions),
+			std::move(normals),
+			std::move(textures),
+			std::move(indices));
+		return true;
+	}
+
+	void MeshStream::Request(const size_t index)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			requested_ = index;
+			has_request_ = true;
+		}
+		condition_.notify_all();
+	}
+
+	void MeshStream::LoaderThread()
+	{
+		while (true)
+		{
+			size_t index = 0;
+			{
+				std::unique_lock<std::mutex> lock(mutex_);
+				condition_.wait(lock, [this]
+				{
+					return stop_ || has_request_;
+				});
+				if (stop_) return;
+				index = requested_;
+				has_request_ = false;
+			}
+			Mesh mesh;
+			const bool ok = ReadChunk(index, mesh);
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				loaded_ = std::move(mesh);
+				loaded_ok_ = ok;
+				has_loaded_ = true;
+			}
+			condition_.notify_all();
+		}
+	}
+
+	void MeshStream::StopLoader()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			stop_ = true;
+		}
+		condition_.notify_all();
+		if (loader_.joinable()) loader_.join();
+	}
+
+}	// End namespace SoftwareGL.
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Mesh.h"
+
+namespace SoftwareGL {
+
+	// Mesh too large to be held in memory (.sgls). The file is cut into
+	// chunks of triangles, each with its own vertices, that are read one at
+	// a time: a background thread reads the next chunk while the current
+	// one is drawn, so no more than two chunks are in memory at once.
+	class MeshStream
+	{
+	public:
+		static constexpr std::uint32_t magic = 0x534c4753;	// "SGLS"
+		static constexpr std::uint32_t version = 1;
+
+	public:
+		// Offline side, cut a mesh into chunks and write them to path.
+		static bool Write(
+			const Mesh& mesh,
+			const std::string& path,
+			const size_t triangles_per_chunk = 64 * 1024);
+
+	public:
+		MeshStream(const size_t memory_budget = 256 * 1024 * 1024) :
+			memory_budget_(memory_budget) {}
+		MeshStream(const MeshStream&) = delete;
+		MeshStream& operator=(const MeshStream&) = delete;
+		virtual ~MeshStream();
+
+	public:
+		// Fail if two chunks don't fit in the memory budget.
+		bool Open(const std::string& path);
+		// Hand every chunk in turn to function on the calling thread, the
+		// chunk can be modified (transformed) and is dropped afterward.
+		// Return false if a chunk could not be read.
+		bool ForEachChunk(const std::function<void(Mesh&)>& function);
+		size_t GetChunkCount() const { return chunks_.size(); }
+		size_t GetTriangleCount() const { return triangle_count_; }
+		size_t GetMaxChunkSize() const { return max_chunk_size_; }
+
+	protected:
+		struct Chunk
+		{
+			std::uint64_t offset;
+			std::uint32_t position_count;
+			std::uint32_t normal_count;
+			std::uint32_t texture_count;
+			std::uint32_t triangle_count;
+		};
+		static size_t GetChunkSize(const Chunk& chunk);
+		// Loader thread only.
+		bool ReadChunk(const size_t index, Mesh& mesh);
+		void Request(const size_t index);
+		void LoaderThread();
+		void StopLoader();
+
+	private:
+		const size_t memory_budget_;
+		std::vector<Chunk> chunks_ = {};
+		size_t triangle_count_ = 0;
+		size_t max_chunk_size_ = 0;
+		std::ifstream file_;
+		// Loader (shared, guarded by mutex_).
+		std::mutex mutex_;
+		std::condition_variable condition_;
+		size_t requested_ = 0;
+		bool has_request_ = false;
+		Mesh loaded_ = {};
+		bool loaded_ok_ = false;
+		bool has_loaded_ = false;
+		bool stop_ = false;
+		std::thread loader_;
+	};
+
+}	// End namespace SoftwareGL.
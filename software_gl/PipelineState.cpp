@@ -0,0 +1,89 @@
+#include "PipelineState.h"
+
+#include <assert.h>
+
+namespace SoftwareGL {
+
+	namespace {
+
+		constexpr size_t blend_mode_count = 3;
+		constexpr size_t cull_mode_count = 3;
+
+	}	// End anonymous namespace.
+
+	bool PipelineState::operator==(const PipelineState& state) const
+	{
+		return
+			depth_test == state.depth_test &&
+			depth_write == state.depth_write &&
+			texturing == state.texturing &&
+			blend == state.blend &&
+			cull == state.cull;
+	}
+
+	std::string PipelineState::GetName() const
+	{
+		std::string name;
+		auto add = [&name](const char* flag)
+		{
+			if (!name.empty()) name += "|";
+			name += flag;
+		};
+		if (depth_test) add("depth_test");
+		if (depth_write) add("depth_write");
+		if (texturing) add("texturing");
+		switch (blend)
+		{
+		case BlendMode::REPLACE:
+			break;
+		case BlendMode::ALPHA:
+			add("blend_alpha");
+			break;
+		case BlendMode::ADD:
+			add("blend_add");
+			break;
+		}
+		switch (cull)
+		{
+		case CullMode::NONE:
+			break;
+		case CullMode::BACK:
+			add("cull_back");
+			break;
+		case CullMode::FRONT:
+			add("cull_front");
+			break;
+		}
+		if (name.empty()) add("none");
+		return name;
+	}
+
+	size_t GetPipelineIndex(const PipelineState& state)
+	{
+		size_t index = state.depth_test ? 1 : 0;
+		index = index * 2 + (state.depth_write ? 1 : 0);
+		index = index * 2 + (state.texturing ? 1 : 0);
+		index = index * blend_mode_count + static_cast<size_t>(state.blend);
+		index = index * cull_mode_count + static_cast<size_t>(state.cull);
+		assert(index < pipeline_state_count);
+		return index;
+	}
+
+	PipelineState GetPipelineState(const size_t index)
+	{
+		assert(index < pipeline_state_count);
+		PipelineState state;
+		size_t rest = index;
+		state.cull = static_cast<CullMode>(rest % cull_mode_count);
+		rest /= cull_mode_count;
+		state.blend = static_cast<BlendMode>(rest % blend_mode_count);
+		rest /= blend_mode_count;
+		state.texturing = rest % 2 != 0;
+		rest /= 2;
+		state.depth_write = rest % 2 != 0;
+		rest /= 2;
+		state.depth_test = rest % 2 != 0;
+		return state;
+	}
+
+}	// End namespace SoftwareGL.
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <string>
+#include <type_traits>
+
+namespace SoftwareGL {
+
+	// How the color of a fragment is combined with the one in the image.
+	enum class BlendMode
+	{
+		// Overwrite it.
+		REPLACE,
+		// Mix with the alpha (w) of the fragment.
+		ALPHA,
+		// Add to it.
+		ADD,
+	};
+
+	// Triangles skipped by their winding on the screen, the faces of a
+	// mesh seen from the front have a negative Triangle::GetArea.
+	enum class CullMode
+	{
+		NONE,
+		// Positive area triangles.
+		BACK,
+		// Negative area triangles.
+		FRONT,
+	};
+
+	// Fixed function state of the draws of a renderer, the rasterizer is
+	// compiled for every combination (see Pipeline) and the one matching
+	// the state is picked once per draw, nothing of it is looked at per
+	// pixel.
+	struct PipelineState
+	{
+		// Reject the fragments behind the z buffer.
+		bool depth_test = true;
+		// Store the z of the fragments drawn.
+		bool depth_write = true;
+		// Shade with the bound texture units (fixed shading only).
+		bool texturing = true;
+		BlendMode blend = BlendMode::REPLACE;
+		CullMode cull = CullMode::NONE;
+
+	public:
+		bool operator==(const PipelineState& state) const;
+		bool operator!=(const PipelineState& state) const
+		{
+			return !operator==(state);
+		}
+		// Readable description (as "depth_test|depth_write|blend_alpha").
+		std::string GetName() const;
+	};
+
+	// Compile time copy of a PipelineState, the type the rasterizer
+	// variants are instantiated on.
+	template <
+		bool DepthTest,
+		bool DepthWrite,
+		bool Texturing,
+		BlendMode Blend,
+		CullMode Cull>
+	struct Pipeline
+	{
+		static constexpr bool depth_test = DepthTest;
+		static constexpr bool depth_write = DepthWrite;
+		static constexpr bool texturing = Texturing;
+		static constexpr BlendMode blend = Blend;
+		static constexpr CullMode cull = Cull;
+		static PipelineState GetState()
+		{
+			return { depth_test, depth_write, texturing, blend, cull };
+		}
+	};
+
+	// Same as Source without texturing, for the variants that don't
+	// shade with the texture units.
+	template <typename Source>
+	using UntexturedPipeline = Pipeline<
+		Source::depth_test,
+		Source::depth_write,
+		false,
+		Source::blend,
+		Source::cull>;
+
+	// The states are numbered, so the variants compiled for them can be
+	// kept in a table.
+	constexpr size_t pipeline_state_count = 2 * 2 * 2 * 3 * 3;
+	size_t GetPipelineIndex(const PipelineState& state);
+	PipelineState GetPipelineState(const size_t index);
+
+	template <typename Function>
+	void DispatchBool(const bool value, Function&& function)
+	{
+		if (value)
+		{
+			function(std::true_type());
+		}
+		else
+		{
+			function(std::false_type());
+		}
+	}
+
+	template <typename Function>
+	void DispatchBlendMode(const BlendMode blend, Function&& function)
+	{
+		switch (blend)
+		{
+		case BlendMode::REPLACE:
+			function(std::integral_constant<
+				BlendMode, BlendMode::REPLACE>());
+			break;
+		case BlendMode::ALPHA:
+			function(std::integral_constant<BlendMode, BlendMode::ALPHA>());
+			break;
+		case BlendMode::ADD:
+			function(std::integral_constant<BlendMode, BlendMode::ADD>());
+			break;
+		}
+	}
+
+	template <typename Function>
+	void DispatchCullMode(const CullMode cull, Function&& function)
+	{
+		switch (cull)
+		{
+		case CullMode::NONE:
+			function(std::integral_constant<CullMode, CullMode::NONE>());
+			break;
+		case CullMode::BACK:
+			function(std::integral_constant<CullMode, CullMode::BACK>());
+			break;
+		case CullMode::FRONT:
+			function(std::integral_constant<CullMode, CullMode::FRONT>());
+			break;
+		}
+	}
+
+	// Call function(Pipeline<...>()) with the Pipeline of state, which
+	// instantiates the function for every state there is.
+	template <typename Function>
+	void DispatchPipeline(const PipelineState& state, Function&& function)
+	{
+		DispatchBool(state.depth_test, [&](auto depth_test)
+		{
+			DispatchBool(state.depth_write, [&](auto depth_write)
+			{
+				DispatchBool(state.texturing, [&](auto texturing)
+				{
+					DispatchBlendMode(state.blend, [&](auto blend)
+					{
+						DispatchCullMode(state.cull, [&](auto cull)
+						{
+							function(Pipeline<
+								decltype(depth_test)::value,
+								decltype(depth_write)::value,
+								decltype(texturing)::value,
+								decltype(blend)::value,
+								decltype(cull)::value>());
+						});
+					});
+				});
+			});
+		});
+	}
+
+}	// End namespace SoftwareGL.
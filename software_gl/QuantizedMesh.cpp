@@ -0,0 +1,240 @@
+#include "QuantizedMesh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace SoftwareGL {
+
+	namespace {
+
+		constexpr float position_steps = 65535.f;
+		constexpr float normal_steps = 32767.f;
+
+		// IEEE 754 binary16, rounded to nearest.
+		std::uint16_t FloatToHalf(const float value)
+		{
+			std::uint32_t bits;
+			std::memcpy(&bits, &value, sizeof(bits));
+			const std::uint16_t sign =
+				static_cast<std::uint16_t>((bits >> 16) & 0x8000);
+			const std::uint32_t abs = bits & 0x7fffffff;
+			// NaN stays NaN, too large goes to infinity.
+			if (abs > 0x7f800000) return sign | 0x7e00;
+			if (abs >= 0x477ff000) return sign | 0x7c00;
+			// Normal range of a half.
+			if (abs >= 0x38800000)
+			{
+				const std::uint32_t rounded = abs - 0x38000000 + 0x1000;
+				return sign | static_cast<std::uint16_t>(rounded >> 13);
+			}
+			// Denormals (and 0), the implicit bit is made explicit.
+			if (abs < 0x33000000) return sign;
+			const std::uint32_t shift = 113 - (abs >> 23) + 13;
+			const std::uint32_t mantissa = (abs & 0x7fffff) | 0x800000;
+			const std::uint32_t rounded =
+				(mantissa + (1u << (shift - 1))) >> shift;
+			return sign | static_cast<std::uint16_t>(rounded);
+		}
+
+		float HalfToFloat(const std::uint16_t half)
+		{
+			const std::uint32_t sign =
+				static_cast<std::uint32_t>(half & 0x8000) << 16;
+			std::uint32_t exponent = (half >> 10) & 0x1f;
+			std::uint32_t mantissa = half & 0x3ff;
+			std::uint32_t bits;
+			if (exponent == 0x1f)
+			{
+				bits = sign | 0x7f800000 | (mantissa << 13);
+			}
+			else if (exponent != 0)
+			{
+				bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+			}
+			else if (mantissa == 0)
+			{
+				bits = sign;
+			}
+			else
+			{
+				// Denormal, normalize it.
+				exponent = 113;
+				while (!(mantissa & 0x400))
+				{
+					mantissa <<= 1;
+					--exponent;
+				}
+				bits = sign | (exponent << 23) | ((mantissa & 0x3ff) << 13);
+			}
+			float value;
+			std::memcpy(&value, &bits, sizeof(value));
+			return value;
+		}
+
+		float SignNotZero(const float value)
+		{
+			return value >= 0.f ? 1.f : -1.f;
+		}
+
+		// Octahedral mapping (Meyer et al., "On Floating-Point Normal
+		// Vectors"), the sphere is projected on an octahedron unfolded
+		// into a square.
+		QuantizedMesh::Normal EncodeNormal(const VectorMath::vector4& n)
+		{
+			const float sum = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+			if (sum <= 0.f) return { 0, 0 };
+			float x = n.x / sum;
+			float y = n.y / sum;
+			if (n.z < 0.f)
+			{
+				const float folded_x = (1.f - std::abs(y)) * SignNotZero(x);
+				const float folded_y = (1.f - std::abs(x)) * SignNotZero(y);
+				x = folded_x;
+				y = folded_y;
+			}
+			return {
+				static_cast<std::int16_t>(std::round(
+					std::clamp(x, -1.f, 1.f) * normal_steps)),
+				static_cast<std::int16_t>(std::round(
+					std::clamp(y, -1.f, 1.f) * normal_steps)) };
+		}
+
+		VectorMath::vector4 DecodeNormal(const QuantizedMesh::Normal& q)
+		{
+			float x = std::max(q[0] / normal_steps, -1.f);
+			float y = std::max(q[1] / normal_steps, -1.f);
+			const float z = 1.f - std::abs(x) - std::abs(y);
+			if (z < 0.f)
+			{
+				const float folded_x = (1.f - std::abs(y)) * SignNotZero(x);
+				const float folded_y = (1.f - std::abs(x)) * SignNotZero(y);
+				x = folded_x;
+				y = folded_y;
+			}
+			const float length = std::sqrt(x * x + y * y + z * z);
+			if (length <= 0.f) return VectorMath::vector4(0, 0, 0, 1);
+			return VectorMath::vector4(
+				x / length,
+				y / length,
+				z / length,
+				1.f);
+		}
+
+	}	// End anonymous namespace.
+
+	QuantizedMesh::QuantizedMesh(const Mesh& mesh) :
+		indices_(mesh.GetIndices()),
+		clusters_(mesh.GetClusters()),
+		bounds_(mesh.GetBounds())
+	{
+		const auto& positions = mesh.GetPositions();
+		if (!positions.empty())
+		{
+			std::array<float, 3> max;
+			min_.fill(std::numeric_limits<float>::max());
+			max.fill(std::numeric_limits<float>::lowest());
+			for (const VectorMath::vector4& p : positions)
+			{
+				const std::array<float, 3> xyz = { p.x, p.y, p.z };
+				for (size_t k = 0; k < 3; ++k)
+				{
+					min_[k] = std::min(min_[k], xyz[k]);
+					max[k] = std::max(max[k], xyz[k]);
+				}
+			}
+			for (size_t k = 0; k < 3; ++k)
+			{
+				scale_[k] = (max[k] - min_[k]) / position_steps;
+			}
+		}
+		positions_.reserve(positions.size());
+		for (const VectorMath::vector4& p : positions)
+		{
+			const std::array<float, 3> xyz = { p.x, p.y, p.z };
+			Position q;
+			for (size_t k = 0; k < 3; ++k)
+			{
+				const float steps = scale_[k] > 0.f ?
+					(xyz[k] - min_[k]) / scale_[k] :
+					0.f;
+				q[k] = static_cast<std::uint16_t>(
+					std::clamp(std::round(steps), 0.f, position_steps));
+			}
+			positions_.push_back(q);
+		}
+		normals_.reserve(mesh.GetNormals().size());
+		for (const VectorMath::vector4& n : mesh.GetNormals())
+		{
+			normals_.push_back(EncodeNormal(n));
+		}
+		textures_.reserve(mesh.GetTextures().size());
+		for (const VectorMath::vector3& t : mesh.GetTextures())
+		{
+			textures_.push_back({ FloatToHalf(t.x), FloatToHalf(t.y) });
+		}
+	}
+
+	void QuantizedMesh::DecodePositions(
+		std::vector<VectorMath::vector4>& positions) const
+	{
+		positions.resize(positions_.size());
+		for (size_t i = 0; i < positions_.size(); ++i)
+		{
+			const Position& q = positions_[i];
+			positions[i] = VectorMath::vector4(
+				min_[0] + q[0] * scale_[0],
+				min_[1] + q[1] * scale_[1],
+				min_[2] + q[2] * scale_[2],
+				1.f);
+		}
+	}
+
+	void QuantizedMesh::DecodeNormals(
+		std::vector<VectorMath::vector4>& normals) const
+	{
+		normals.resize(normals_.size());
+		for (size_t i = 0; i < normals_.size(); ++i)
+		{
+			normals[i] = DecodeNormal(normals_[i]);
+		}
+	}
+
+	void QuantizedMesh::DecodeTextures(
+		std::vector<VectorMath::vector3>& textures) const
+	{
+		textures.resize(textures_.size());
+		for (size_t i = 0; i < textures_.size(); ++i)
+		{
+			textures[i] = VectorMath::vector3(
+				HalfToFloat(textures_[i][0]),
+				HalfToFloat(textures_[i][1]),
+				1.f);
+		}
+	}
+
+	VectorMath::matrix QuantizedMesh::GetPositionMatrix() const
+	{
+		VectorMath::matrix result;
+		result.ScaleMatrix(scale_[0], scale_[1], scale_[2]);
+		result._41 = min_[0];
+		result._42 = min_[1];
+		result._43 = min_[2];
+		return result;
+	}
+
+	VectorMath::vector4 QuantizedMesh::GetNormal(const size_t index) const
+	{
+		return DecodeNormal(normals_[index]);
+	}
+
+	size_t QuantizedMesh::GetAttributeSize() const
+	{
+		return
+			positions_.size() * sizeof(Position) +
+			normals_.size() * sizeof(Normal) +
+			textures_.size() * sizeof(Texture);
+	}
+
+}	// End namespace SoftwareGL.
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+#include "Frustum.h"
+#include "Mesh.h"
+#include "MeshCluster.h"
+#include "VectorMath.h"
+
+namespace SoftwareGL {
+
+	// Compact copy of the attributes of a Mesh: positions on 16 bit per
+	// component relative to the bounding box, octahedral normals on 2 x 16
+	// bit and texture coordinates as half floats, 14 bytes instead of 44 for
+	// one of each. Indices and clusters are kept as they are, the flat
+	// OpenGL buffers are not kept. It is decoded straight into the buffers
+	// of the vertex stage (see VertexProcessor::Process).
+	class QuantizedMesh
+	{
+	public:
+		using Position = std::array<std::uint16_t, 3>;
+		using Normal = std::array<std::int16_t, 2>;
+		using Texture = std::array<std::uint16_t, 2>;
+
+	public:
+		QuantizedMesh() = default;
+		explicit QuantizedMesh(const Mesh& mesh);
+
+	public:
+		// Decode to the layout of Mesh (w of positions and normals and z of
+		// texture coordinates set to 1 as the OBJ loader does).
+		void DecodePositions(std::vector<VectorMath::vector4>& positions) const;
+		void DecodeNormals(std::vector<VectorMath::vector4>& normals) const;
+		void DecodeTextures(std::vector<VectorMath::vector3>& textures) const;
+		// Quantized positions and the matrix that decodes them (as floats
+		// with w = 1), so it can be concatenated with the transformations.
+		const std::vector<Position>& GetPositions() const
+		{
+			return positions_;
+		}
+		VectorMath::matrix GetPositionMatrix() const;
+		size_t GetNormalCount() const { return normals_.size(); }
+		// Bounds of the source mesh.
+		const BoundingVolume& GetBounds() const { return bounds_; }
+		VectorMath::vector4 GetNormal(const size_t index) const;
+		const std::vector<std::array<int, 3>>& GetIndices() const
+		{
+			return indices_;
+		}
+		const std::vector<MeshCluster>& GetClusters() const
+		{
+			return clusters_;
+		}
+		// Bytes used by the positions, normals and textures.
+		size_t GetAttributeSize() const;
+
+	private:
+		// Position = min + quantized * scale.
+		std::array<float, 3> min_ = {};
+		std::array<float, 3> scale_ = {};
+		std::vector<Position> positions_ = {};
+		std::vector<Normal> normals_ = {};
+		std::vector<Texture> textures_ = {};
+		std::vector<std::array<int, 3>> indices_ = {};
+		std::vector<MeshCluster> clusters_ = {};
+		BoundingVolume bounds_ = {};
+	};
+
+}	// End namespace SoftwareGL.
@@ -1,5 +1,7 @@
 #include "Renderer.h"
 #include <algorithm>
+#include <cmath>
+#include <functional>
 #include <vector>
 #include <tuple>
 #if defined(_WIN32) | defined(_WIN64)
@@ -14,11 +16,166 @@ namespace SoftwareGL {
 		const VectorMath::vector& color, 
 		const float z_max)
 	{
+		// New frame, let the virtual textures install their loaded pages.
+		for (TextureUnit& unit : texture_units_) unit.Update();
+		culled_clusters_ = 0;
+		culled_objects_ = 0;
 		z_buffer_.resize(image_.size());
 		std::fill(image_.begin(), image_.end(), color);
 		std::fill(z_buffer_.begin(), z_buffer_.end(), z_max);
 	}
 
+	void Renderer::SetTexture(
+		std::shared_ptr<const Image> texture,
+		const unsigned int slot /*= 0*/)
+	{
+		assert(slot < max_texture_units);
+		texture_units_[slot].SetTexture(texture);
+	}
+
+	void Renderer::SetTexture(
+		std::shared_ptr<const TextureFile> texture,
+		const unsigned int slot /*= 0*/)
+	{
+		assert(slot < max_texture_units);
+		texture_units_[slot].SetTexture(texture);
+	}
+
+	void Renderer::SetVirtualTexture(
+		std::shared_ptr<VirtualTexture> texture,
+		const unsigned int slot /*= 0*/)
+	{
+		assert(slot < max_texture_units);
+		texture_units_[slot].SetVirtualTexture(texture);
+	}
+
+	void Renderer::SetSampler(
+		const Sampler& sampler,
+		const unsigned int slot /*= 0*/)
+	{
+		assert(slot < max_texture_units);
+		texture_units_[slot].SetSampler(sampler);
+	}
+
+	void Renderer::SetTextureUnit(
+		const TextureUnit& unit,
+		const unsigned int slot /*= 0*/)
+	{
+		assert(slot < max_texture_units);
+		texture_units_[slot] = unit;
+	}
+
+	float Renderer::ComputeTextureLod(
+		const Triangle& tri,
+		const float width,
+		const float height) const
+	{
+		// Ratio of the texel footprint to the pixel footprint of the
+		// triangle, every level divide the texel area by 4.
+		const float screen_area = std::abs(tri.GetArea());
+		if (screen_area < VectorMath::epsilon) return 0.f;
+		auto uv = [](const Vertex& v)
+		{
+			const VectorMath::vector3 t = v.GetTexture();
+			return VectorMath::vector2(t.x / t.z, t.y / t.z);
+		};
+		const VectorMath::vector2 a = uv(tri.GetV1());
+		const VectorMath::vector2 b = uv(tri.GetV2());
+		const VectorMath::vector2 c = uv(tri.GetV3());
+		const float uv_area = 0.5f * std::abs(
+			(b.x - a.x) * (c.y - a.y) - (c.x - a.x) * (b.y - a.y));
+		const float texel_area = uv_area * width * height;
+		if (texel_area <= screen_area) return 0.f;
+		return 0.5f * std::log2(texel_area / screen_area);
+	}
+
+	void Renderer::GatherTextureUnits()
+	{
+		active_unit_count_ = 0;
+		for (unsigned int slot = 0; slot < max_texture_units; ++slot)
+		{
+			if (!texture_units_[slot].IsBound()) continue;
+			active_units_[active_unit_count_++] = slot;
+		}
+	}
+
+	void Renderer::SetTextureLods(const Triangle& tri)
+	{
+		for (size_t i = 0; i < active_unit_count_; ++i)
+		{
+			TextureUnit& unit = texture_units_[active_units_[i]];
+			unit.SetLod(
+				ComputeTextureLod(tri, unit.GetWidth(), unit.GetHeight()));
+		}
+	}
+
+	const std::array<Renderer::RasterizeFunction, pipeline_state_count>&
+		Renderer::GetRasterizers()
+	{
+		static const auto rasterizers = []
+		{
+			std::array<RasterizeFunction, pipeline_state_count> table = {};
+			for (size_t i = 0; i < pipeline_state_count; ++i)
+			{
+				const PipelineState state = SoftwareGL::GetPipelineState(i);
+				DispatchPipeline(state, [&](auto pipeline)
+				{
+					table[i] = &Renderer::RasterizeTriangle<
+						decltype(pipeline)>;
+				});
+			}
+			return table;
+		}();
+		return rasterizers;
+	}
+
+	std::vector<PipelineState> Renderer::GetRasterizerVariants()
+	{
+		std::vector<PipelineState> states;
+		const auto& rasterizers = GetRasterizers();
+		for (size_t i = 0; i < rasterizers.size(); ++i)
+		{
+			if (!rasterizers[i]) continue;
+			states.push_back(SoftwareGL::GetPipelineState(i));
+		}
+		return states;
+	}
+
+	PipelineState Renderer::GetDrawState(const bool textured) const
+	{
+		PipelineState state = pipeline_state_;
+		state.texturing = textured;
+		if (z_buffer_.empty())
+		{
+			state.depth_test = false;
+			state.depth_write = false;
+		}
+		return state;
+	}
+
+	Renderer::RasterizeFunction Renderer::SelectRasterizer()
+	{
+		active_unit_count_ = 0;
+		if (pipeline_state_.texturing) GatherTextureUnits();
+		return GetRasterizers()[
+			GetPipelineIndex(GetDrawState(active_unit_count_ > 0))];
+	}
+
+	bool Renderer::DepthTest(const size_t index, const float z)
+	{
+		assert(index < image_.size());
+		if (!z_buffer_.empty())
+		{
+			assert(index < z_buffer_.size());
+			if (z_buffer_[index] <= z)
+			{
+				return false;
+			}
+			z_buffer_[index] = z;
+		}
+		return true;
+	}
+
 	void Renderer::DrawPixel(const Vertex& v)
 	{
 		const float width = image_.GetWidth();
@@ -32,31 +189,9 @@ namespace SoftwareGL {
 			static_cast<size_t>(v.GetX()) +
 			static_cast<size_t>(v.GetY()) * 
 			static_cast<size_t>(width);
-		assert(index < z_buffer_.size());
-		if (!z_buffer_.empty())
-		{
-			if (z_buffer_[index] <= v.GetZ())
-			{
-				return;
-			}
-			z_buffer_[index] = v.GetZ();
-		}
-		VectorMath::vector4 color = v.GetColor();
-		if (texture_.GetWidth() > 1 && texture_.GetHeight() > 1)
-		{
-			const int dx = static_cast<int>(texture_.GetWidth());
-			const int dy = static_cast<int>(texture_.GetHeight());
-			float ut = (v.GetTexture().x / v.GetTexture().z) * dx;
-			float vt = (v.GetTexture().y / v.GetTexture().z) * dy;
-			int iut = static_cast<int>(ut);
-			int ivt = static_cast<int>(vt);
-			iut = std::clamp<int>(iut, 0, dx - 1);
-			ivt = std::clamp<int>(ivt, 0, dy - 1);
-			const int index = iut + ivt * dx;
-			color |= texture_[index];
-		}
+		if (!DepthTest(index, v.GetZ())) return;
 		// Draw the pixel
-		image_[index] = color;
+		image_[index] = v.GetColor();
 	}
 
 	void Renderer::DrawLine(const Vertex& v1, const Vertex& v2)
@@ -141,79 +276,332 @@ namespace SoftwareGL {
 
 	// Draw triangle using barycentric coordinate.
 	// Using barycentric coordinate to interpolate colors.
-	// Also doesn't account for triangle order, and no Z-buffer yet.
 	void Renderer::DrawTriangle(const Triangle& tri)
+	{
+		(this->*SelectRasterizer())(tri);
+	}
+
+	void Renderer::DrawMesh(
+		const VertexProcessor& vertices,
+		const VectorMath::matrix& model_view_projection,
+		const VectorMath::vector& camera_position,
+		const size_t instance /*= 0*/)
+	{
+		// State and texture units are resolved once for the draw, the
+		// untextured variant doesn't look at the texture units at all.
+		const RasterizeFunction rasterize = SelectRasterizer();
+		ForEachVisibleTriangle(
+			vertices,
+			model_view_projection,
+			camera_position,
+			pipeline_state_.cull,
+			[&](const size_t triangle)
+		{
+			(this->*rasterize)(vertices.GetTriangle(triangle, instance));
+		});
+	}
+
+	void Renderer::Submit(const DrawItem& item)
+	{
+		assert(item.mesh || item.compact_mesh);
+		draw_items_.push_back(item);
+	}
+
+	void Renderer::DrawScene(
+		const VectorMath::matrix& view,
+		const VectorMath::matrix& projection)
+	{
+		SortDrawItems(view, projection);
+		const VectorMath::vector camera_world = GetCameraPosition(view);
+		// Objects without texture come first, with the units of the
+		// renderer.
+		const TextureUnit* bound = nullptr;
+		for (const DrawOrder& order : draw_order_)
+		{
+			const DrawItem& item = draw_items_[order.item];
+			if (item.texture && item.texture != bound)
+			{
+				if (!bound) scene_albedo_ = texture_units_[ALBEDO_SLOT];
+				texture_units_[ALBEDO_SLOT] = *item.texture;
+				bound = item.texture;
+			}
+			DrawMesh(
+				vertex_processor_,
+				item.model * view * projection,
+				ProcessDrawItem(item, view, projection, camera_world));
+		}
+		if (bound) texture_units_[ALBEDO_SLOT] = scene_albedo_;
+		draw_items_.clear();
+	}
+
+	void Renderer::SortDrawItems(
+		const VectorMath::matrix& view,
+		const VectorMath::matrix& projection)
+	{
+		const Frustum frustum(view * projection);
+		draw_order_.clear();
+		for (size_t i = 0; i < draw_items_.size(); ++i)
+		{
+			const DrawItem& item = draw_items_[i];
+			const BoundingVolume& bounds = item.GetBounds();
+			if (frustum.IsOutside(bounds, item.model))
+			{
+				++culled_objects_;
+				continue;
+			}
+			// View depth of the center of the bounds.
+			const VectorMath::vector center = VectorMath::VectorMult(
+				VectorMath::vector(
+					bounds.center[0],
+					bounds.center[1],
+					bounds.center[2],
+					1.f),
+				item.model * view);
+			draw_order_.push_back({ item.texture, center.z, i });
+		}
+		std::sort(
+			draw_order_.begin(),
+			draw_order_.end(),
+			[](const DrawOrder& a, const DrawOrder& b)
+		{
+			if (a.texture != b.texture)
+			{
+				return std::less<const TextureUnit*>()(a.texture, b.texture);
+			}
+			return a.depth < b.depth;
+		});
+	}
+
+	VectorMath::vector Renderer::ProcessDrawItem(
+		const DrawItem& item,
+		const VectorMath::matrix& view,
+		const VectorMath::matrix& projection,
+		const VectorMath::vector& camera_world)
+	{
+		if (item.compact_mesh)
+		{
+			vertex_processor_.Process(
+				*item.compact_mesh,
+				item.model,
+				view,
+				projection,
+				image_.GetWidth(),
+				image_.GetHeight());
+		}
+		else
+		{
+			vertex_processor_.Process(
+				*item.mesh,
+				item.model,
+				view,
+				projection,
+				image_.GetWidth(),
+				image_.GetHeight());
+		}
+		// Clusters are culled in model space.
+		VectorMath::matrix world_to_model = item.model;
+		world_to_model.Inverse();
+		return VectorMath::VectorMult(camera_world, world_to_model);
+	}
+
+	void Renderer::DrawInstanced(
+		const Mesh& mesh,
+		const BufferView<Instance>& instances,
+		const VectorMath::matrix& view,
+		const VectorMath::matrix& projection)
+	{
+		if (instances.empty()) return;
+		const VectorMath::matrix view_projection = view * projection;
+		const VectorMath::matrix view_screen = view_projection *
+			VectorMath::Viewport(image_.GetWidth(), image_.GetHeight());
+		const Frustum frustum(view_projection);
+		const VectorMath::vector camera_world = GetCameraPosition(view);
+		vertex_processor_.SetMesh(mesh);
+		// Enough instances of a small mesh to keep the kernels busy, few
+		// enough to still be in cache when they are rasterized.
+		const size_t batch_size = std::max<size_t>(
+			1,
+			instance_batch_vertices /
+				std::max<size_t>(1, mesh.GetPositions().size()));
+		visible_instances_.clear();
+		for (const Instance& instance : instances)
+		{
+			if (frustum.IsOutside(mesh.GetBounds(), instance.model))
+			{
+				++culled_objects_;
+				continue;
+			}
+			visible_instances_.push_back(instance);
+			if (visible_instances_.size() == batch_size)
+			{
+				DrawInstanceBatch(view_projection, view_screen, camera_world);
+			}
+		}
+		if (!visible_instances_.empty())
+		{
+			DrawInstanceBatch(view_projection, view_screen, camera_world);
+		}
+	}
+
+	void Renderer::DrawInstanceBatch(
+		const VectorMath::matrix& view_projection,
+		const VectorMath::matrix& view_screen,
+		const VectorMath::vector& camera_position)
+	{
+		vertex_processor_.ProcessInstances(
+			visible_instances_.data(),
+			visible_instances_.size(),
+			view_screen);
+		for (size_t i = 0; i < visible_instances_.size(); ++i)
+		{
+			const VectorMath::matrix& model = visible_instances_[i].model;
+			VectorMath::matrix world_to_model = model;
+			world_to_model.Inverse();
+			DrawMesh(
+				vertex_processor_,
+				model * view_projection,
+				VectorMath::VectorMult(camera_position, world_to_model),
+				i);
+		}
+		visible_instances_.clear();
+	}
+
+	VectorMath::vector Renderer::GetCameraPosition(
+		const VectorMath::matrix& view)
+	{
+		VectorMath::matrix camera_to_world = view;
+		camera_to_world.Inverse();
+		return VectorMath::vector(
+			camera_to_world._41,
+			camera_to_world._42,
+			camera_to_world._43,
+			1.f);
+	}
+
+	size_t Renderer::SelectLod(
+		const MeshLod& lod,
+		const VectorMath::matrix& model_view,
+		const VectorMath::matrix& projection,
+		const float pixel_error /*= 1.f*/) const
+	{
+		if (lod.GetLevelCount() < 2) return 0;
+		// Largest scale of the model view, errors are in model units.
+		const VectorMath::matrix& m = model_view;
+		const float scale = std::sqrt(std::max({
+			m._11 * m._11 + m._12 * m._12 + m._13 * m._13,
+			m._21 * m._21 + m._22 * m._22 + m._23 * m._23,
+			m._31 * m._31 + m._32 * m._32 + m._33 * m._33 }));
+		const BoundingVolume& bounds = lod.GetBounds();
+		const VectorMath::vector center = VectorMath::VectorMult(
+			VectorMath::vector(
+				bounds.center[0],
+				bounds.center[1],
+				bounds.center[2],
+				1.f),
+			model_view);
+		const float distance = center.z - bounds.radius * scale;
+		// The camera is in (or too close to) the sphere.
+		if (distance <= VectorMath::epsilon) return 0;
+		// Pixels per unit at a distance of 1.
+		const float pixels = projection._22 * image_.GetHeight() * .5f;
+		for (size_t level = lod.GetLevelCount() - 1; level > 0; --level)
+		{
+			const float error =
+				lod.GetLevel(level).error * scale * pixels / distance;
+			if (error <= pixel_error) return level;
+		}
+		return 0;
+	}
+
+	template <typename Pipeline>
+	void Renderer::RasterizeTriangle(const Triangle& tri)
 	{
 		static const VectorMath::vector4 light = { 0, 0, -1, 0 };
-		// Get the bounding box.
-		VectorMath::vector4 border = tri.GetBorder();
-		// Get if current point is in triangle using barycentric coordinates.
-		for (auto x = static_cast<int>(border.x); x < border.z; ++x)
+		if constexpr (Pipeline::texturing) SetTextureLods(tri);
+		// Constant over the triangle.
+		const bool are_normal_different =
+			abs((tri.GetV1().GetNormal() -
+				tri.GetV2().GetNormal()).LengthSquared()) <
+				VectorMath::epsilon &&
+			abs((tri.GetV1().GetNormal() -
+				tri.GetV3().GetNormal()).LengthSquared()) <
+				VectorMath::epsilon;
+		ScanTriangle<Pipeline>(tri, [&](
+			const float s,
+			const float t,
+			const float u)
 		{
-			if ((x < 0.0f) || (x > image_.GetWidth() - 1)) continue;
-			for (auto y = static_cast<int>(border.y); y < border.w; ++y)
+			// Interpolate color using s & t.
+			VectorMath::vector4 normal;
+			if (are_normal_different)
 			{
-				if ((y < 0.0f) || (y > image_.GetHeight() - 1)) continue;
-				// Compute barycentric coordinates.
-				const float s = tri.GetBarycentricS(VectorMath::vector2(
-					static_cast<float>(x),
-					static_cast<float>(y)));
-				if ((s < 0.0f) || (s > 1.0f)) continue;
-				const float t = tri.GetBarycentricT(VectorMath::vector2(
-					static_cast<float>(x),
-					static_cast<float>(y)));
-				if ((t < 0.0f) || (t > 1.0f)) continue;
-				const float u = 1.f - (s + t);
-				if ((u < 0.0f) || (u > 1.0f)) continue;
-				assert((1 - (s + t + u)) < VectorMath::epsilon);
-				// Compute z using barycentric coordinates.
-				const float z =
-					tri.GetV1().GetZ() * s +
-					tri.GetV2().GetZ() * t +
-					tri.GetV3().GetZ() * u;
-				// Interpolate color using s & t.
-				float shade = 1.0f;
-				const bool are_normal_different =
-					abs((tri.GetV1().GetNormal() -
-						tri.GetV2().GetNormal()).LengthSquared()) <
-						VectorMath::epsilon &&
-					abs((tri.GetV1().GetNormal() -
-						tri.GetV3().GetNormal()).LengthSquared()) <
-						VectorMath::epsilon;
-				VectorMath::vector4 normal;
-				if (are_normal_different)
-				{
-					normal =
-						tri.GetV1().GetNormal() * s +
-						tri.GetV2().GetNormal() * t +
-						tri.GetV3().GetNormal() * u;
-				}
-				else
-				{
-					normal = tri.GetV1().GetNormal();
-				}
-				shade = normal * light;
-				VectorMath::vector4 color =
-					tri.GetV1().GetColor() * s +
-					tri.GetV2().GetColor() * t +
-					tri.GetV3().GetColor() * u;
-				color *= shade;
-				VectorMath::vector3 uv =
+				normal =
+					tri.GetV1().GetNormal() * s +
+					tri.GetV2().GetNormal() * t +
+					tri.GetV3().GetNormal() * u;
+			}
+			else
+			{
+				normal = tri.GetV1().GetNormal();
+			}
+			VectorMath::vector4 color =
+				tri.GetV1().GetColor() * s +
+				tri.GetV2().GetColor() * t +
+				tri.GetV3().GetColor() * u;
+			// Taken before the shading scales the color.
+			float alpha = color.w;
+			if constexpr (Pipeline::texturing)
+			{
+				const VectorMath::vector3 uv =
 					tri.GetV1().GetTexture() * s +
 					tri.GetV2().GetTexture() * t +
 					tri.GetV3().GetTexture() * u;
-				const Vertex v(
-					VectorMath::vector4(
-						static_cast<float>(x),
-						static_cast<float>(y),
-						z,
-						1),
-					color,
-					normal,
-					uv);
-				DrawPixel(v);
+				const float tu = uv.x / uv.z;
+				const float tv = uv.y / uv.z;
+				VectorMath::vector4 albedo = { 1, 1, 1, 1 };
+				VectorMath::vector4 emissive = { 0, 0, 0, 0 };
+				float occlusion = 1.f;
+				for (size_t i = 0; i < active_unit_count_; ++i)
+				{
+					const unsigned int slot = active_units_[i];
+					const VectorMath::vector4 texel =
+						texture_units_[slot].Sample(tu, tv);
+					switch (slot)
+					{
+					case ALBEDO_SLOT:
+						albedo = texel;
+						break;
+					case NORMAL_SLOT:
+						// Stored as [0, 1], in the same space as the
+						// vertex normals.
+						normal = texel * 2.f - VectorMath::vector4(1.f);
+						normal.w = 0.f;
+						normal.Normalize();
+						break;
+					case OCCLUSION_SLOT:
+						occlusion = texel.x;
+						break;
+					case EMISSIVE_SLOT:
+						emissive = texel;
+						emissive.w = 0.f;
+						break;
+					}
+				}
+				alpha *= albedo.w;
+				color *= (normal * light) * occlusion;
+				color |= albedo;
+				color += emissive;
 			}
-		}
+			else
+			{
+				color *= normal * light;
+			}
+			if constexpr (Pipeline::blend == BlendMode::ALPHA)
+			{
+				color.w = alpha;
+			}
+			return color;
+		});
 	}
 
 }	// End of namespace SoftwareGL.
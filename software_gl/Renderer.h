@@ -1,32 +1,500 @@
 #pragma once
 
 #include "Image.h"
+#include <algorithm>
+#include <array>
 #include <memory>
+#include <assert.h>
+#include "TextureFile.h"
+#include "TextureUnit.h"
+#include "VirtualTexture.h"
 #include "Camera.h"
+#include "Frustum.h"
 #include "Mesh.h"
+#include "MeshLod.h"
+#include "PipelineState.h"
+#include "QuantizedMesh.h"
+#include "Shader.h"
 #include "Triangle.h"
 #include "VectorMath.h"
 #include "Vertex.h"
+#include "VertexCache.h"
+#include "VertexProcessor.h"
 
 namespace SoftwareGL {
 
+	// Meaning of the texture slots for the fragment stage.
+	enum TextureSlot : unsigned int
+	{
+		// Multiply the color.
+		ALBEDO_SLOT = 0,
+		// Replace the normal, stored as [0, 1] in the same space as the
+		// vertex normals.
+		NORMAL_SLOT = 1,
+		// Red channel multiply the shade.
+		OCCLUSION_SLOT = 2,
+		// Added to the color.
+		EMISSIVE_SLOT = 3,
+	};
+
+	// Object of a scene (see Renderer::Submit). The mesh and the texture
+	// are not copied, they have to live until the scene is drawn.
+	struct DrawItem
+	{
+		const Mesh* mesh = nullptr;
+		// Model to world.
+		VectorMath::matrix model = {};
+		// Replace the unit of ALBEDO_SLOT for this object, nullptr keeps
+		// the units set on the renderer.
+		const TextureUnit* texture = nullptr;
+		// Drawn instead of mesh when it is set.
+		const QuantizedMesh* compact_mesh = nullptr;
+
+	public:
+		const BoundingVolume& GetBounds() const
+		{
+			return compact_mesh ? compact_mesh->GetBounds() : mesh->GetBounds();
+		}
+	};
+
 	class Renderer {
 	public:
-		Renderer(Image image) : texture_(1, 1), image_(image) {}
+		static constexpr unsigned int max_texture_units = 4;
+		// Vertices transformed at once by DrawInstanced.
+		static constexpr size_t instance_batch_vertices = 16384;
+
+	public:
+		Renderer(Image image) : image_(image) {}
 
 	public:
 		void ClearFrame(const VectorMath::vector& color, const float z_max);
+		// State of the triangles drawn from now on.
+		void SetPipelineState(const PipelineState& state)
+		{
+			pipeline_state_ = state;
+		}
+		const PipelineState& GetPipelineState() const
+		{
+			return pipeline_state_;
+		}
+		// States the triangle rasterizer is compiled for, one variant
+		// each.
+		static std::vector<PipelineState> GetRasterizerVariants();
 		void DrawPixel(const Vertex& v);
 		void DrawLine(const Vertex& v1, const Vertex& v2);
 		void DrawTriangle(const Triangle& tri);
+		// Same with the shading given by the shaders (see Shader.h) instead
+		// of the texture units, the texturing of the state is ignored.
+		template <typename VertexShader, typename FragmentShader>
+		void DrawTriangle(
+			const Triangle& tri,
+			const VertexShader& vertex_shader,
+			const FragmentShader& fragment_shader);
+		// Draw (an instance of) the mesh last transformed by the vertex
+		// stage. Its clusters (see Mesh::BuildClusters) keep their model
+		// space bounds, the ones out of the view of model_view_projection
+		// are skipped whole, as are the ones facing away from the camera
+		// (at camera_position in model space) when the state culls back
+		// faces, or facing it when it culls front faces. A mesh without
+		// clusters is drawn completely.
+		void DrawMesh(
+			const VertexProcessor& vertices,
+			const VectorMath::matrix& model_view_projection,
+			const VectorMath::vector& camera_position,
+			const size_t instance = 0);
+		// Same with shaders, a vertex goes through the vertex shader once
+		// and its output is kept in the cache for the other triangles that
+		// share it.
+		template <typename VertexShader, typename FragmentShader>
+		void DrawMesh(
+			const VertexProcessor& vertices,
+			const VectorMath::matrix& model_view_projection,
+			const VectorMath::vector& camera_position,
+			const VertexShader& vertex_shader,
+			const FragmentShader& fragment_shader,
+			VertexCache<VaryingsOf<VertexShader>>& cache,
+			const size_t instance = 0);
+		// Draw copies of a mesh seen through view and projection. The mesh
+		// is set up once, the instances in view are transformed by batches
+		// and drawn with their own cluster culling.
+		void DrawInstanced(
+			const Mesh& mesh,
+			const BufferView<Instance>& instances,
+			const VectorMath::matrix& view,
+			const VectorMath::matrix& projection);
+		// Queue an object for DrawScene.
+		void Submit(const DrawItem& item);
+		// Draw the queued objects seen through view and projection and
+		// empty the queue. Objects out of the view are skipped, the others
+		// are grouped by texture (a change of binding copies the unit) and
+		// drawn front to back in each group so the depth test rejects
+		// more pixels. Everything is opaque.
+		void DrawScene(
+			const VectorMath::matrix& view,
+			const VectorMath::matrix& projection);
+		// Same with shaders (see DrawMesh), the textures of the objects are
+		// not bound.
+		template <typename VertexShader, typename FragmentShader>
+		void DrawScene(
+			const VectorMath::matrix& view,
+			const VectorMath::matrix& projection,
+			const VertexShader& vertex_shader,
+			const FragmentShader& fragment_shader,
+			VertexCache<VaryingsOf<VertexShader>>& cache);
+		// Coarsest level of the chain whose error, projected at the closest
+		// point of the bounding sphere, stays under pixel_error pixels.
+		size_t SelectLod(
+			const MeshLod& lod,
+			const VectorMath::matrix& model_view,
+			const VectorMath::matrix& projection,
+			const float pixel_error = 1.f) const;
+		// Clusters skipped since the last ClearFrame.
+		size_t GetCulledClusterCount() const { return culled_clusters_; }
+		// Objects of DrawScene and instances of DrawInstanced skipped since
+		// the last ClearFrame.
+		size_t GetCulledObjectCount() const { return culled_objects_; }
 		const Image& GetImage() const { return image_; }
-		void SetTexture(const Image& texture) { texture_ = texture; }
+		// Texture is shared (see AssetCache), nullptr unbind the slot.
+		void SetTexture(
+			std::shared_ptr<const Image> texture,
+			const unsigned int slot = 0);
+		// Texture with precomputed mips, a level is picked per triangle.
+		void SetTexture(
+			std::shared_ptr<const TextureFile> texture,
+			const unsigned int slot = 0);
+		// Paged texture, its pages are streamed in as they get sampled.
+		void SetVirtualTexture(
+			std::shared_ptr<VirtualTexture> texture,
+			const unsigned int slot = 0);
+		void SetSampler(const Sampler& sampler, const unsigned int slot = 0);
+		// Texture and sampler at once.
+		void SetTextureUnit(
+			const TextureUnit& unit,
+			const unsigned int slot = 0);
+
+	protected:
+		using RasterizeFunction = void (Renderer::*)(const Triangle&);
+		// Variant of the rasterizer for each state, by GetPipelineIndex.
+		static const std::array<RasterizeFunction, pipeline_state_count>&
+			GetRasterizers();
+		// State a draw runs with: textured if it shades with texture units
+		// and no depth without z buffer (before the first ClearFrame).
+		PipelineState GetDrawState(const bool textured) const;
+		// Once per draw, gather the bound texture units and pick the
+		// variant of the rasterizer.
+		RasterizeFunction SelectRasterizer();
+		// Position of the camera of view in world space.
+		static VectorMath::vector GetCameraPosition(
+			const VectorMath::matrix& view);
+		// Cull the queued objects and order the others in draw_order_.
+		void SortDrawItems(
+			const VectorMath::matrix& view,
+			const VectorMath::matrix& projection);
+		// Run the vertex stage on an object of the scene and return the
+		// camera (at camera_world) in its model space.
+		VectorMath::vector ProcessDrawItem(
+			const DrawItem& item,
+			const VectorMath::matrix& view,
+			const VectorMath::matrix& projection,
+			const VectorMath::vector& camera_world);
+		// Transform and draw visible_instances_, view_projection goes to
+		// the clip space and view_screen to the screen.
+		void DrawInstanceBatch(
+			const VectorMath::matrix& view_projection,
+			const VectorMath::matrix& view_screen,
+			const VectorMath::vector& camera_position);
+		// Gather the bound units in the active list.
+		void GatherTextureUnits();
+		// Select the level of every active unit for the triangle.
+		void SetTextureLods(const Triangle& tri);
+		// Mip level from the texel to pixel ratio of the triangle.
+		float ComputeTextureLod(
+			const Triangle& tri,
+			const float width,
+			const float height) const;
+		// Check and update the z buffer, for points and lines.
+		bool DepthTest(const size_t index, const float z);
+		// Call draw(triangle) with the index of the triangles of the
+		// clusters that pass the culling of DrawMesh, the normal cone is
+		// tested against the faces cull removes (not at all for NONE).
+		template <typename Function>
+		void ForEachVisibleTriangle(
+			const VertexProcessor& vertices,
+			const VectorMath::matrix& model_view_projection,
+			const VectorMath::vector& camera_position,
+			const CullMode cull,
+			Function draw);
+		// Call shade(s, t, u) for the pixels of the triangle that pass the
+		// depth test, with their barycentric coordinates, and blend the
+		// color it returns into the image. The state is the one of
+		// Pipeline.
+		template <typename Pipeline, typename Function>
+		void ScanTriangle(const Triangle& tri, Function shade);
+		template <typename Pipeline>
+		void RasterizeTriangle(const Triangle& tri);
+		// Rasterize with the varyings of the corners of tri.
+		template <
+			typename Pipeline,
+			typename Varyings,
+			typename FragmentShader>
+		void ShadeTriangle(
+			const Triangle& tri,
+			const Varyings& v1,
+			const Varyings& v2,
+			const Varyings& v3,
+			const FragmentShader& fragment_shader);
 
 	private:
-		Image texture_;
+		PipelineState pipeline_state_ = {};
+		std::array<TextureUnit, max_texture_units> texture_units_ = {};
+		// Slots bound for the draw in flight.
+		std::array<unsigned int, max_texture_units> active_units_ = {};
+		size_t active_unit_count_ = 0;
+		size_t culled_clusters_ = 0;
+		size_t culled_objects_ = 0;
 		std::vector<float> z_buffer_;
-		std::vector<Mesh> meshes_;
+		// Scene queued by Submit and the order it is drawn in, both keep
+		// their capacity from one frame to the next.
+		struct DrawOrder
+		{
+			const TextureUnit* texture;
+			float depth;
+			size_t item;
+		};
+		std::vector<DrawItem> draw_items_ = {};
+		std::vector<DrawOrder> draw_order_ = {};
+		// Unit of ALBEDO_SLOT set aside while the textures of the draw
+		// list are bound.
+		TextureUnit scene_albedo_ = {};
+		// Instances in view of the batch in flight.
+		std::vector<Instance> visible_instances_ = {};
+		VertexProcessor vertex_processor_ = {};
 		Image image_;
 	};
 
+	template <typename VertexShader, typename FragmentShader>
+	void Renderer::DrawTriangle(
+		const Triangle& tri,
+		const VertexShader& vertex_shader,
+		const FragmentShader& fragment_shader)
+	{
+		const auto v1 = vertex_shader(tri.GetV1());
+		const auto v2 = vertex_shader(tri.GetV2());
+		const auto v3 = vertex_shader(tri.GetV3());
+		DispatchPipeline(GetDrawState(false), [&](auto pipeline)
+		{
+			ShadeTriangle<UntexturedPipeline<decltype(pipeline)>>(
+				tri,
+				v1,
+				v2,
+				v3,
+				fragment_shader);
+		});
+	}
+
+	template <typename VertexShader, typename FragmentShader>
+	void Renderer::DrawMesh(
+		const VertexProcessor& vertices,
+		const VectorMath::matrix& model_view_projection,
+		const VectorMath::vector& camera_position,
+		const VertexShader& vertex_shader,
+		const FragmentShader& fragment_shader,
+		VertexCache<VaryingsOf<VertexShader>>& cache,
+		const size_t instance /*= 0*/)
+	{
+		using Output = typename VertexCache<VaryingsOf<VertexShader>>::Output;
+		// Welded vertices are the exact key, without them the corners go
+		// through the small cache.
+		const BufferView<unsigned int> welded = vertices.GetVertexIndices();
+		const bool indexed =
+			cache.GetMode() == VertexCacheMode::INDEXED && !welded.empty();
+		cache.Begin(indexed ? vertices.GetVertexCount() : 0);
+		// The variant is picked once for the whole mesh.
+		DispatchPipeline(GetDrawState(false), [&](auto pipeline)
+		{
+			ForEachVisibleTriangle(
+				vertices,
+				model_view_projection,
+				camera_position,
+				decltype(pipeline)::cull,
+				[&](const size_t triangle)
+			{
+				// Copied, a fetch can replace the entry of the one before.
+				const auto fetch = [&](const size_t corner) -> Output
+				{
+					const auto shade = [&]
+					{
+						const Vertex vertex =
+							vertices.GetVertex(corner, instance);
+						return Output{ vertex, vertex_shader(vertex) };
+					};
+					if (indexed) return cache.Fetch(welded[corner], shade);
+					return cache.Fetch(vertices.GetVertexKey(corner), shade);
+				};
+				const Output v1 = fetch(triangle * 3);
+				const Output v2 = fetch(triangle * 3 + 1);
+				const Output v3 = fetch(triangle * 3 + 2);
+				ShadeTriangle<UntexturedPipeline<decltype(pipeline)>>(
+					Triangle(v1.vertex, v2.vertex, v3.vertex),
+					v1.varyings,
+					v2.varyings,
+					v3.varyings,
+					fragment_shader);
+			});
+		});
+	}
+
+	template <typename VertexShader, typename FragmentShader>
+	void Renderer::DrawScene(
+		const VectorMath::matrix& view,
+		const VectorMath::matrix& projection,
+		const VertexShader& vertex_shader,
+		const FragmentShader& fragment_shader,
+		VertexCache<VaryingsOf<VertexShader>>& cache)
+	{
+		SortDrawItems(view, projection);
+		const VectorMath::vector camera_world = GetCameraPosition(view);
+		for (const DrawOrder& order : draw_order_)
+		{
+			const DrawItem& item = draw_items_[order.item];
+			DrawMesh(
+				vertex_processor_,
+				item.model * view * projection,
+				ProcessDrawItem(item, view, projection, camera_world),
+				vertex_shader,
+				fragment_shader,
+				cache);
+		}
+		draw_items_.clear();
+	}
+
+	template <
+		typename Pipeline,
+		typename Varyings,
+		typename FragmentShader>
+	void Renderer::ShadeTriangle(
+		const Triangle& tri,
+		const Varyings& v1,
+		const Varyings& v2,
+		const Varyings& v3,
+		const FragmentShader& fragment_shader)
+	{
+		ScanTriangle<Pipeline>(tri, [&](
+			const float s,
+			const float t,
+			const float u)
+		{
+			return fragment_shader(InterpolateVaryings(v1, v2, v3, s, t, u));
+		});
+	}
+
+	template <typename Function>
+	void Renderer::ForEachVisibleTriangle(
+		const VertexProcessor& vertices,
+		const VectorMath::matrix& model_view_projection,
+		const VectorMath::vector& camera_position,
+		const CullMode cull,
+		Function draw)
+	{
+		const BufferView<MeshCluster> clusters = vertices.GetClusters();
+		if (clusters.empty())
+		{
+			for (size_t i = 0; i < vertices.GetTriangleCount(); ++i)
+			{
+				draw(i);
+			}
+			return;
+		}
+		for (const MeshCluster& cluster : clusters)
+		{
+			// The cone test is the cheaper one, it only removes the
+			// clusters whose every face is culled anyway.
+			const bool face_culled =
+				(cull == CullMode::BACK &&
+					cluster.IsBackFacing(camera_position)) ||
+				(cull == CullMode::FRONT &&
+					cluster.IsFrontFacing(camera_position));
+			if (face_culled || cluster.IsOutside(model_view_projection))
+			{
+				++culled_clusters_;
+				continue;
+			}
+			const size_t end =
+				cluster.first_triangle + cluster.triangle_count;
+			for (size_t i = cluster.first_triangle; i < end; ++i)
+			{
+				draw(i);
+			}
+		}
+	}
+
+	template <typename Pipeline, typename Function>
+	void Renderer::ScanTriangle(const Triangle& tri, Function shade)
+	{
+		if constexpr (Pipeline::cull == CullMode::BACK)
+		{
+			if (tri.GetArea() > 0.f) return;
+		}
+		else if constexpr (Pipeline::cull == CullMode::FRONT)
+		{
+			if (tri.GetArea() < 0.f) return;
+		}
+		const size_t width = static_cast<size_t>(image_.GetWidth());
+		// Get the bounding box (clipped to the image).
+		VectorMath::vector4 border = tri.GetBorder();
+		const int x_begin = std::max(static_cast<int>(border.x), 0);
+		const float x_end = std::min(border.z, image_.GetWidth() - 1);
+		const int y_begin = std::max(static_cast<int>(border.y), 0);
+		const float y_end = std::min(border.w, image_.GetHeight() - 1);
+		const float z1 = tri.GetV1().GetZ();
+		const float z2 = tri.GetV2().GetZ();
+		const float z3 = tri.GetV3().GetZ();
+		// Get if current point is in triangle using barycentric coordinates.
+		for (auto x = x_begin; x <= x_end && x < border.z; ++x)
+		{
+			for (auto y = y_begin; y <= y_end && y < border.w; ++y)
+			{
+				// Compute barycentric coordinates.
+				const float s = tri.GetBarycentricS(VectorMath::vector2(
+					static_cast<float>(x),
+					static_cast<float>(y)));
+				if ((s < 0.0f) || (s > 1.0f)) continue;
+				const float t = tri.GetBarycentricT(VectorMath::vector2(
+					static_cast<float>(x),
+					static_cast<float>(y)));
+				if ((t < 0.0f) || (t > 1.0f)) continue;
+				const float u = 1.f - (s + t);
+				if ((u < 0.0f) || (u > 1.0f)) continue;
+				assert((1 - (s + t + u)) < VectorMath::epsilon);
+				// Compute z using barycentric coordinates.
+				const float z = z1 * s + z2 * t + z3 * u;
+				const size_t index =
+					static_cast<size_t>(x) + static_cast<size_t>(y) * width;
+				assert(index < image_.size());
+				if constexpr (Pipeline::depth_test)
+				{
+					if (z_buffer_[index] <= z) continue;
+				}
+				if constexpr (Pipeline::depth_write)
+				{
+					z_buffer_[index] = z;
+				}
+				const VectorMath::vector4 color = shade(s, t, u);
+				if constexpr (Pipeline::blend == BlendMode::REPLACE)
+				{
+					image_[index] = color;
+				}
+				else if constexpr (Pipeline::blend == BlendMode::ALPHA)
+				{
+					image_[index] =
+						color * color.w + image_[index] * (1.f - color.w);
+				}
+				else
+				{
+					image_[index] += color;
+				}
+			}
+		}
+	}
+
 }	// End of namespace SoftwareGL.
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstring>
+#include <type_traits>
+#include <utility>
+#include "VectorMath.h"
+#include "Vertex.h"
+
+namespace SoftwareGL {
+
+	// Programmable stages of Renderer::DrawTriangle and DrawMesh, given as
+	// functor types so the rasterizer is compiled for each pair of them and
+	// everything inlines (no virtual call, no attribute that isn't used).
+	//
+	// A vertex shader turns a vertex of the vertex stage (its position is
+	// already in pixels) into the varyings of the fragment shader:
+	//     Varyings operator()(const Vertex& v) const;
+	// A fragment shader turns the varyings interpolated at a pixel into its
+	// color:
+	//     VectorMath::vector4 operator()(const Varyings& in) const;
+	// Varyings is a trivially copyable struct made of floats only (float
+	// arrays, the VectorMath vectors have a copy constructor of their own),
+	// it is interpolated one float after the other so only what it declares
+	// is computed. The interpolation is linear in screen space, divide by a
+	// w carried along for a perspective correct one (the way
+	// Vertex::GetTexture is stored).
+
+	template <typename VertexShader>
+	using VaryingsOf = decltype(
+		std::declval<const VertexShader&>()(std::declval<const Vertex&>()));
+
+	// Weighted sum of the varyings of the 3 vertices of a triangle.
+	template <typename Varyings>
+	inline Varyings InterpolateVaryings(
+		const Varyings& v1,
+		const Varyings& v2,
+		const Varyings& v3,
+		const float s,
+		const float t,
+		const float u)
+	{
+		static_assert(
+			std::is_trivially_copyable<Varyings>::value &&
+			std::is_standard_layout<Varyings>::value &&
+			sizeof(Varyings) % sizeof(float) == 0,
+			"Varyings has to be a trivially copyable struct of floats.");
+		constexpr size_t count = sizeof(Varyings) / sizeof(float);
+		// Copied as floats, the copies are optimized out.
+		float a[count];
+		float b[count];
+		float c[count];
+		std::memcpy(a, &v1, sizeof(Varyings));
+		std::memcpy(b, &v2, sizeof(Varyings));
+		std::memcpy(c, &v3, sizeof(Varyings));
+		for (size_t i = 0; i < count; ++i)
+		{
+			a[i] = a[i] * s + b[i] * t + c[i] * u;
+		}
+		Varyings result;
+		std::memcpy(&result, a, sizeof(Varyings));
+		return result;
+	}
+
+	// Shading of the untextured draws: color of the vertices lit by a
+	// directional light.
+	struct LambertVertexShader
+	{
+		struct Varyings
+		{
+			float color[4];
+			float normal[3];
+		};
+		Varyings operator()(const Vertex& v) const
+		{
+			const VectorMath::vector4 color = v.GetColor();
+			const VectorMath::vector4 normal = v.GetNormal();
+			return {
+				{ color.x, color.y, color.z, color.w },
+				{ normal.x, normal.y, normal.z } };
+		}
+	};
+
+	struct LambertFragmentShader
+	{
+		// Direction the light goes toward, in the space of the normals.
+		VectorMath::vector4 light = { 0, 0, -1, 0 };
+		VectorMath::vector4 operator()(
+			const LambertVertexShader::Varyings& in) const
+		{
+			const float shade =
+				in.normal[0] * light.x +
+				in.normal[1] * light.y +
+				in.normal[2] * light.z;
+			return VectorMath::vector4(
+				in.color[0] * shade,
+				in.color[1] * shade,
+				in.color[2] * shade,
+				in.color[3] * shade);
+		}
+	};
+
+}	// End namespace SoftwareGL.
@@ -0,0 +1,141 @@
+#include "TextureFile.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+namespace SoftwareGL {
+
+	namespace {
+
+		struct texture_file_level
+		{
+			std::uint64_t offset;
+			std::uint32_t width;
+			std::uint32_t height;
+		};
+
+		struct texture_file_header
+		{
+			std::uint32_t magic;
+			std::uint32_t version;
+			std::uint32_t level_count;
+			// Size of a texel, guard against a different vector layout.
+			std::uint32_t texel_size;
+			texture_file_level levels[TextureFile::max_levels];
+		};
+
+		size_t AlignUp(size_t value)
+		{
+			return (value + TextureFile::alignment - 1) &
+				~(TextureFile::alignment - 1);
+		}
+
+	}	// End anonymous namespace.
+
+	Image TextureFile::Downsample(const ImageView& image)
+	{
+		const size_t dx = image.GetSize().first;
+		const size_t dy = image.GetSize().second;
+		Image result(std::max<size_t>(1, dx / 2), std::max<size_t>(1, dy / 2));
+		const size_t rx = result.GetSize().first;
+		const size_t ry = result.GetSize().second;
+		for (size_t y = 0; y < ry; ++y)
+		{
+			const size_t y0 = std::min(y * 2, dy - 1);
+			const size_t y1 = std::min(y * 2 + 1, dy - 1);
+			for (size_t x = 0; x < rx; ++x)
+			{
+				const size_t x0 = std::min(x * 2, dx - 1);
+				const size_t x1 = std::min(x * 2 + 1, dx - 1);
+				result[x + y * rx] =
+					(image[x0 + y0 * dx] +
+						image[x1 + y0 * dx] +
+						image[x0 + y1 * dx] +
+						image[x1 + y1 * dx]) * .25f;
+			}
+		}
+		return result;
+	}
+
+	bool TextureFile::Write(const Image& image, const std::string& path)
+	{
+		if (image.empty()) return false;
+		// Build the mip chain down to 1x1.
+		std::vector<Image> mips = { image };
+		while (mips.back().size() > 1 && mips.size() < max_levels)
+		{
+			const Image& last = mips.back();
+			mips.push_back(Downsample(
+				ImageView(
+					last.data(),
+					last.GetSize().first,
+					last.GetSize().second)));
+		}
+		texture_file_header header{};
+		header.magic = magic;
+		header.version = version;
+		header.level_count = static_cast<std::uint32_t>(mips.size());
+		header.texel_size = sizeof(VectorMath::vector);
+		size_t offset = AlignUp(sizeof(header));
+		for (size_t i = 0; i < mips.size(); ++i)
+		{
+			header.levels[i].offset = offset;
+			header.levels[i].width =
+				static_cast<std::uint32_t>(mips[i].GetSize().first);
+			header.levels[i].height =
+				static_cast<std::uint32_t>(mips[i].GetSize().second);
+			offset = AlignUp(offset + mips[i].size() * header.texel_size);
+		}
+		std::ofstream ofs(path, std::ios::binary);
+		if (!ofs.is_open()) return false;
+		ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		std::vector<char> padding(alignment, 0);
+		size_t written = sizeof(header);
+		for (size_t i = 0; i < mips.size(); ++i)
+		{
+			ofs.write(padding.data(), header.levels[i].offset - written);
+			const size_t bytes = mips[i].size() * header.texel_size;
+			ofs.write(reinterpret_cast<const char*>(mips[i].data()), bytes);
+			written = header.levels[i].offset + bytes;
+		}
+		// Pad the end so the last level is a whole number of pages.
+		ofs.write(padding.data(), AlignUp(written) - written);
+		return ofs.good();
+	}
+
+	bool TextureFile::Open(const std::string& path)
+	{
+		levels_.clear();
+		if (!file_.Open(path)) return false;
+		texture_file_header header;
+		if (file_.GetSize() < sizeof(header)) return false;
+		std::memcpy(&header, file_.GetData(), sizeof(header));
+		if (header.magic != magic) return false;
+		if (header.version != version) return false;
+		if (header.texel_size != sizeof(VectorMath::vector)) return false;
+		if (header.level_count == 0) return false;
+		if (header.level_count > max_levels) return false;
+		for (std::uint32_t i = 0; i < header.level_count; ++i)
+		{
+			const texture_file_level& level = header.levels[i];
+			const size_t bytes =
+				static_cast<size_t>(level.width) * level.height *
+				header.texel_size;
+			if (level.offset % alignment != 0 ||
+				level.offset + bytes > file_.GetSize())
+			{
+				levels_.clear();
+				return false;
+			}
+			// Point straight into the mapping.
+			levels_.emplace_back(
+				reinterpret_cast<const VectorMath::vector*>(
+					file_.GetData() + level.offset),
+				level.width,
+				level.height);
+		}
+		return true;
+	}
+
+}	// End namespace SoftwareGL.
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Image.h"
+#include "ImageView.h"
+#include "MappedFile.h"
+
+namespace SoftwareGL {
+
+	// Binary texture container (.sglt) holding a full mip chain as RGBA
+	// floats, the in-memory layout of an Image. Every level starts on a
+	// page boundary so that opening the file costs no decode and no copy,
+	// and only the levels that are actually read get paged in.
+	class TextureFile
+	{
+	public:
+		static constexpr std::uint32_t magic = 0x544c4753;	// "SGLT"
+		static constexpr std::uint32_t version = 1;
+		static constexpr size_t max_levels = 32;
+		static constexpr size_t alignment = 4096;
+
+	public:
+		// Offline side, compute the mips of image and write them to path.
+		static bool Write(const Image& image, const std::string& path);
+		// Halve an image (box filter), used to build the mip chain.
+		static Image Downsample(const ImageView& image);
+
+	public:
+		bool Open(const std::string& path);
+		size_t GetLevelCount() const { return levels_.size(); }
+		const ImageView& GetLevel(size_t level) const
+		{
+			return levels_[level];
+		}
+		const std::vector<ImageView>& GetLevels() const { return levels_; }
+
+	private:
+		MappedFile file_;
+		std::vector<ImageView> levels_ = {};
+	};
+
+}	// End namespace SoftwareGL.
@@ -0,0 +1,129 @@
+#include "TextureUnit.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace SoftwareGL {
+
+	void TextureUnit::SetTexture(std::shared_ptr<const Image> texture)
+	{
+		owner_ = texture;
+		levels_.clear();
+		virtual_texture_ = nullptr;
+		level_ = 0;
+		// A 1x1 (or empty) image means no texture.
+		if (texture && texture->GetWidth() > 1 && texture->GetHeight() > 1)
+		{
+			levels_.emplace_back(
+				texture->data(),
+				texture->GetSize().first,
+				texture->GetSize().second);
+		}
+	}
+
+	void TextureUnit::SetTexture(std::shared_ptr<const TextureFile> texture)
+	{
+		owner_ = texture;
+		levels_.clear();
+		virtual_texture_ = nullptr;
+		level_ = 0;
+		if (texture) levels_ = texture->GetLevels();
+	}
+
+	void TextureUnit::SetVirtualTexture(
+		std::shared_ptr<VirtualTexture> texture)
+	{
+		owner_ = nullptr;
+		levels_.clear();
+		virtual_texture_ = texture;
+		level_ = 0;
+	}
+
+	float TextureUnit::GetWidth() const
+	{
+		if (virtual_texture_) return virtual_texture_->GetWidth();
+		return levels_.empty() ? 0.f : levels_[0].GetWidth();
+	}
+
+	float TextureUnit::GetHeight() const
+	{
+		if (virtual_texture_) return virtual_texture_->GetHeight();
+		return levels_.empty() ? 0.f : levels_[0].GetHeight();
+	}
+
+	void TextureUnit::Update()
+	{
+		if (virtual_texture_) virtual_texture_->Update();
+	}
+
+	void TextureUnit::SetLod(const float lod)
+	{
+		lod_ = sampler_.mipmap ? lod : 0.f;
+		level_ = levels_.empty() ? 0 : std::min(
+			static_cast<size_t>(lod_),
+			levels_.size() - 1);
+	}
+
+	VectorMath::vector TextureUnit::Fetch(
+		const ImageView& level,
+		int x,
+		int y) const
+	{
+		const int dx = static_cast<int>(level.GetWidth());
+		const int dy = static_cast<int>(level.GetHeight());
+		if (sampler_.wrap_s == WrapMode::REPEAT)
+		{
+			x %= dx;
+			if (x < 0) x += dx;
+		}
+		else
+		{
+			x = std::clamp<int>(x, 0, dx - 1);
+		}
+		if (sampler_.wrap_t == WrapMode::REPEAT)
+		{
+			y %= dy;
+			if (y < 0) y += dy;
+		}
+		else
+		{
+			y = std::clamp<int>(y, 0, dy - 1);
+		}
+		return level[x + y * dx];
+	}
+
+	VectorMath::vector TextureUnit::Sample(float u, float v) const
+	{
+		if (virtual_texture_)
+		{
+			if (sampler_.wrap_s == WrapMode::REPEAT) u -= std::floor(u);
+			if (sampler_.wrap_t == WrapMode::REPEAT) v -= std::floor(v);
+			return virtual_texture_->Sample(u, v, lod_);
+		}
+		const ImageView& level = levels_[level_];
+		const float ut = u * level.GetWidth();
+		const float vt = v * level.GetHeight();
+		if (sampler_.filter == FilterMode::NEAREST)
+		{
+			return Fetch(
+				level,
+				static_cast<int>(std::floor(ut)),
+				static_cast<int>(std::floor(vt)));
+		}
+		// Bilinear between the 4 closest texel centers.
+		const float fu = ut - .5f;
+		const float fv = vt - .5f;
+		const float x0 = std::floor(fu);
+		const float y0 = std::floor(fv);
+		const float a = fu - x0;
+		const float b = fv - y0;
+		const int ix = static_cast<int>(x0);
+		const int iy = static_cast<int>(y0);
+		return
+			(Fetch(level, ix, iy) * (1.f - a) +
+				Fetch(level, ix + 1, iy) * a) * (1.f - b) +
+			(Fetch(level, ix, iy + 1) * (1.f - a) +
+				Fetch(level, ix + 1, iy + 1) * a) * b;
+	}
+
+}	// End namespace SoftwareGL.
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include "Image.h"
+#include "ImageView.h"
+#include "TextureFile.h"
+#include "VectorMath.h"
+#include "VirtualTexture.h"
+
+namespace SoftwareGL {
+
+	enum class WrapMode
+	{
+		REPEAT,
+		CLAMP_TO_EDGE,
+	};
+
+	enum class FilterMode
+	{
+		NEAREST,
+		LINEAR,
+	};
+
+	// Sampler state, kept apart from the texture as with OpenGL sampler
+	// objects so the same texture can be read in different ways.
+	struct Sampler
+	{
+		WrapMode wrap_s = WrapMode::CLAMP_TO_EDGE;
+		WrapMode wrap_t = WrapMode::CLAMP_TO_EDGE;
+		FilterMode filter = FilterMode::NEAREST;
+		// Use the mip levels if the texture has any.
+		bool mipmap = true;
+	};
+
+	// A texture slot of the renderer, the texture bound to it (plain image,
+	// mip chain or virtual texture) and the sampler used to read it.
+	class TextureUnit
+	{
+	public:
+		// Binding, nullptr unbind the slot.
+		void SetTexture(std::shared_ptr<const Image> texture);
+		void SetTexture(std::shared_ptr<const TextureFile> texture);
+		void SetVirtualTexture(std::shared_ptr<VirtualTexture> texture);
+		void SetSampler(const Sampler& sampler) { sampler_ = sampler; }
+		const Sampler& GetSampler() const { return sampler_; }
+		bool IsBound() const
+		{
+			return !levels_.empty() || virtual_texture_ != nullptr;
+		}
+		// Size of the base level.
+		float GetWidth() const;
+		float GetHeight() const;
+
+	public:
+		// Once per frame (stream the pages of a virtual texture).
+		void Update();
+		// Once per draw, select the level used by Sample.
+		void SetLod(const float lod);
+		// Sample at normalized coordinates.
+		VectorMath::vector Sample(float u, float v) const;
+
+	protected:
+		VectorMath::vector Fetch(const ImageView& level, int x, int y) const;
+
+	private:
+		// Keep the texture memory alive, the levels point into it.
+		std::shared_ptr<const void> owner_ = nullptr;
+		std::vector<ImageView> levels_ = {};
+		std::shared_ptr<VirtualTexture> virtual_texture_ = nullptr;
+		Sampler sampler_ = {};
+		size_t level_ = 0;
+		float lod_ = 0.f;
+	};
+
+}	// End namespace SoftwareGL.
@@ -3,15 +3,6 @@
 
 namespace SoftwareGL {
 
-	Triangle& Triangle::operator=(const Triangle& triangle)
-	{
-		v1_ = triangle.v1_;
-		v2_ = triangle.v2_;
-		v3_ = triangle.v3_;
-		SetVertexConst();
-		return *this;
-	}
-
 	float SoftwareGL::Triangle::GetArea() const
 	{
 		return area_;
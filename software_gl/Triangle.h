@@ -10,17 +10,14 @@ namespace SoftwareGL {
 	{
 	public:
 		Triangle() = default;
-		Triangle(const Triangle& triangle) : 
-			v1_(triangle.v1_), v2_(triangle.v2_), v3_(triangle.v3_) 
-		{
-			SetVertexConst();
-		}
+		// The setup constants are copied along, not computed again.
+		Triangle(const Triangle& triangle) = default;
 		Triangle(const Vertex& v1, const Vertex& v2, const Vertex& v3) :
 			v1_(v1), v2_(v2), v3_(v3) 
 		{
 			SetVertexConst();
 		}
-		Triangle& operator=(const Triangle& triangle);
+		Triangle& operator=(const Triangle& triangle) = default;
 
 	public:
 		float GetArea() const;
@@ -64,9 +61,9 @@ namespace SoftwareGL {
 		Vertex v2_ = {};
 		Vertex v3_ = {};
 		// Some constants that are fixed for barycentric calculations.
-		float area_;
-		float den_;
-		VectorMath::vector4 border_;
+		float area_ = 0.f;
+		float den_ = 0.f;
+		VectorMath::vector4 border_ = {};
 	};
 
 }	// End namespace SoftwareGL.
@@ -0,0 +1,285 @@
+#include "VectorBatch.h"
+
+#if defined(__x86_64__) | defined(_M_X64) | \
+	defined(__i386__) | defined(_M_IX86)
+#define ENABLE_BATCH_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// Functions that may use AVX2 and FMA, the rest of the file is built for
+// the baseline of the compiler.
+#if defined(ENABLE_BATCH_X86) & !defined(_MSC_VER)
+#define TARGET_AVX2 __attribute__((target("avx2,fma")))
+#else
+#define TARGET_AVX2
+#endif
+
+namespace {
+
+	using VectorMath::matrix;
+	using VectorMath::vector;
+
+	using BatchFunction = void (*)(
+		const vector*, const matrix&, vector*, size_t);
+
+	struct Kernels
+	{
+		BatchFunction batch;
+		BatchFunction batch_divide;
+		const char* name;
+	};
+
+	template <bool divide>
+	void VectorMultBatchScalar(
+		const vector* in,
+		const matrix& m,
+		vector* out,
+		size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			vector v = VectorMath::VectorMult(in[i], m);
+			if constexpr (divide) v *= 1 / v.w;
+			out[i] = v;
+		}
+	}
+
+#ifdef ENABLE_BATCH_X86
+
+	// Every element of the matrix in all lanes.
+	struct MatrixSse
+	{
+		explicit MatrixSse(const matrix& m)
+		{
+			const float* elements = &m._11;
+			for (int i = 0; i < 16; ++i) e[i] = _mm_set1_ps(elements[i]);
+		}
+		__m128 e[16];
+	};
+
+	inline void TransformSse(
+		const MatrixSse& m,
+		__m128& x, __m128& y, __m128& z, __m128& w)
+	{
+		const __m128 ox = _mm_add_ps(
+			_mm_add_ps(_mm_mul_ps(x, m.e[0]), _mm_mul_ps(y, m.e[4])),
+			_mm_add_ps(_mm_mul_ps(z, m.e[8]), _mm_mul_ps(w, m.e[12])));
+		const __m128 oy = _mm_add_ps(
+			_mm_add_ps(_mm_mul_ps(x, m.e[1]), _mm_mul_ps(y, m.e[5])),
+			_mm_add_ps(_mm_mul_ps(z, m.e[9]), _mm_mul_ps(w, m.e[13])));
+		const __m128 oz = _mm_add_ps(
+			_mm_add_ps(_mm_mul_ps(x, m.e[2]), _mm_mul_ps(y, m.e[6])),
+			_mm_add_ps(_mm_mul_ps(z, m.e[10]), _mm_mul_ps(w, m.e[14])));
+		const __m128 ow = _mm_add_ps(
+			_mm_add_ps(_mm_mul_ps(x, m.e[3]), _mm_mul_ps(y, m.e[7])),
+			_mm_add_ps(_mm_mul_ps(z, m.e[11]), _mm_mul_ps(w, m.e[15])));
+		x = ox;
+		y = oy;
+		z = oz;
+		w = ow;
+	}
+
+	template <bool divide>
+	void VectorMultBatchSse(
+		const vector* in,
+		const matrix& m,
+		vector* out,
+		size_t count)
+	{
+		const MatrixSse ms(m);
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			const float* src = &in[i].x;
+			// 4 vectors to x, y, z and w streams.
+			__m128 vx = _mm_loadu_ps(src);
+			__m128 vy = _mm_loadu_ps(src + 4);
+			__m128 vz = _mm_loadu_ps(src + 8);
+			__m128 vw = _mm_loadu_ps(src + 12);
+			_MM_TRANSPOSE4_PS(vx, vy, vz, vw);
+			TransformSse(ms, vx, vy, vz, vw);
+			if constexpr (divide)
+			{
+				const __m128 inv = _mm_div_ps(_mm_set1_ps(1.f), vw);
+				vx = _mm_mul_ps(vx, inv);
+				vy = _mm_mul_ps(vy, inv);
+				vz = _mm_mul_ps(vz, inv);
+				vw = _mm_mul_ps(vw, inv);
+			}
+			_MM_TRANSPOSE4_PS(vx, vy, vz, vw);
+			float* dst = &out[i].x;
+			_mm_storeu_ps(dst, vx);
+			_mm_storeu_ps(dst + 4, vy);
+			_mm_storeu_ps(dst + 8, vz);
+			_mm_storeu_ps(dst + 12, vw);
+		}
+		VectorMultBatchScalar<divide>(in + i, m, out + i, count - i);
+	}
+
+	struct MatrixAvx2
+	{
+		TARGET_AVX2 explicit MatrixAvx2(const matrix& m)
+		{
+			const float* elements = &m._11;
+			for (int i = 0; i < 16; ++i)
+			{
+				e[i] = _mm256_set1_ps(elements[i]);
+			}
+		}
+		__m256 e[16];
+	};
+
+	TARGET_AVX2 inline void TransformAvx2(
+		const MatrixAvx2& m,
+		__m256& x, __m256& y, __m256& z, __m256& w)
+	{
+		const __m256 ox = _mm256_fmadd_ps(x, m.e[0],
+			_mm256_fmadd_ps(y, m.e[4],
+				_mm256_fmadd_ps(z, m.e[8], _mm256_mul_ps(w, m.e[12]))));
+		const __m256 oy = _mm256_fmadd_ps(x, m.e[1],
+			_mm256_fmadd_ps(y, m.e[5],
+				_mm256_fmadd_ps(z, m.e[9], _mm256_mul_ps(w, m.e[13]))));
+		const __m256 oz = _mm256_fmadd_ps(x, m.e[2],
+			_mm256_fmadd_ps(y, m.e[6],
+				_mm256_fmadd_ps(z, m.e[10], _mm256_mul_ps(w, m.e[14]))));
+		const __m256 ow = _mm256_fmadd_ps(x, m.e[3],
+			_mm256_fmadd_ps(y, m.e[7],
+				_mm256_fmadd_ps(z, m.e[11], _mm256_mul_ps(w, m.e[15]))));
+		x = ox;
+		y = oy;
+		z = oz;
+		w = ow;
+	}
+
+	template <bool divide>
+	TARGET_AVX2 void VectorMultBatchAvx2(
+		const vector* in,
+		const matrix& m,
+		vector* out,
+		size_t count)
+	{
+		const MatrixAvx2 ms(m);
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			const float* src = &in[i].x;
+			// 2 vectors per register, transposed inside the 128 bit lanes:
+			// the streams hold vectors 0 2 4 6 1 3 5 7, the transpose back
+			// puts them in order again.
+			const __m256 a = _mm256_loadu_ps(src);
+			const __m256 b = _mm256_loadu_ps(src + 8);
+			const __m256 c = _mm256_loadu_ps(src + 16);
+			const __m256 d = _mm256_loadu_ps(src + 24);
+			const __m256 t0 = _mm256_unpacklo_ps(a, b);
+			const __m256 t1 = _mm256_unpackhi_ps(a, b);
+			const __m256 t2 = _mm256_unpacklo_ps(c, d);
+			const __m256 t3 = _mm256_unpackhi_ps(c, d);
+			__m256 vx = _mm256_shuffle_ps(t0, t2, 0x44);
+			__m256 vy = _mm256_shuffle_ps(t0, t2, 0xee);
+			__m256 vz = _mm256_shuffle_ps(t1, t3, 0x44);
+			__m256 vw = _mm256_shuffle_ps(t1, t3, 0xee);
+			TransformAvx2(ms, vx, vy, vz, vw);
+			if constexpr (divide)
+			{
+				const __m256 inv = _mm256_div_ps(_mm256_set1_ps(1.f), vw);
+				vx = _mm256_mul_ps(vx, inv);
+				vy = _mm256_mul_ps(vy, inv);
+				vz = _mm256_mul_ps(vz, inv);
+				vw = _mm256_mul_ps(vw, inv);
+			}
+			const __m256 u0 = _mm256_unpacklo_ps(vx, vy);
+			const __m256 u1 = _mm256_unpackhi_ps(vx, vy);
+			const __m256 u2 = _mm256_unpacklo_ps(vz, vw);
+			const __m256 u3 = _mm256_unpackhi_ps(vz, vw);
+			float* dst = &out[i].x;
+			_mm256_storeu_ps(dst, _mm256_shuffle_ps(u0, u2, 0x44));
+			_mm256_storeu_ps(dst + 8, _mm256_shuffle_ps(u0, u2, 0xee));
+			_mm256_storeu_ps(dst + 16, _mm256_shuffle_ps(u1, u3, 0x44));
+			_mm256_storeu_ps(dst + 24, _mm256_shuffle_ps(u1, u3, 0xee));
+		}
+		VectorMultBatchSse<divide>(in + i, m, out + i, count - i);
+	}
+
+	bool HasAvx2()
+	{
+#ifdef _MSC_VER
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7) return false;
+		__cpuid(info, 1);
+		const bool fma = (info[2] & (1 << 12)) != 0;
+		const bool os_saves_avx = (info[2] & (1 << 27)) != 0 &&
+			(_xgetbv(0) & 6) == 6;
+		__cpuidex(info, 7, 0);
+		const bool avx2 = (info[1] & (1 << 5)) != 0;
+		return fma && os_saves_avx && avx2;
+#else
+		__builtin_cpu_init();
+		return
+			__builtin_cpu_supports("avx2") &&
+			__builtin_cpu_supports("fma");
+#endif
+	}
+
+#endif	// ENABLE_BATCH_X86
+
+	Kernels SelectKernels()
+	{
+#ifdef ENABLE_BATCH_X86
+		if (HasAvx2())
+		{
+			return {
+				VectorMultBatchAvx2<false>,
+				VectorMultBatchAvx2<true>,
+				"avx2" };
+		}
+		// SSE is part of every x86 target the project builds for.
+		return {
+			VectorMultBatchSse<false>,
+			VectorMultBatchSse<true>,
+			"sse" };
+#else
+		return {
+			VectorMultBatchScalar<false>,
+			VectorMultBatchScalar<true>,
+			"scalar" };
+#endif
+	}
+
+	const Kernels& GetKernels()
+	{
+		static const Kernels kernels = SelectKernels();
+		return kernels;
+	}
+
+}	// End anonymous namespace.
+
+namespace VectorMath {
+
+	void VectorMultBatch(
+		const vector* in,
+		const matrix& m,
+		vector* out,
+		const size_t count)
+	{
+		GetKernels().batch(in, m, out, count);
+	}
+
+	void VectorMultDivideBatch(
+		const vector* in,
+		const matrix& m,
+		vector* out,
+		const size_t count)
+	{
+		GetKernels().batch_divide(in, m, out, count);
+	}
+
+	const char* GetBatchKernelName()
+	{
+		return GetKernels().name;
+	}
+
+} // end namespace VectorMath.
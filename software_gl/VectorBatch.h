@@ -0,0 +1,60 @@
+#pragma once
+
+#include <algorithm>
+#include <numeric>
+#include <vector>
+#if defined(_WIN32) | defined(_WIN64)
+#include <execution>
+#endif
+#include <stddef.h>
+#include "VectorMath.h"
+
+namespace VectorMath {
+
+	// Transformations of many vectors at once (v·M as VectorMult). The
+	// vectors are transposed to streams of x, y, z and w in registers, 8
+	// vectors per step with AVX2 and FMA, 4 with SSE, the kernels are
+	// picked once for the CPU running the program. Output may be the same
+	// memory as the input.
+
+	// Vectors as an array of vector.
+	void VectorMultBatch(
+		const vector* in,
+		const matrix& m,
+		vector* out,
+		const size_t count);
+	// Same followed by the divide by w.
+	void VectorMultDivideBatch(
+		const vector* in,
+		const matrix& m,
+		vector* out,
+		const size_t count);
+	// Kernels in use: "avx2", "sse" or "scalar".
+	const char* GetBatchKernelName();
+
+	// Vectors per block when a batch is split over threads, small enough
+	// for a block to stay in cache from one kernel to the next.
+	constexpr size_t batch_block_size = 256;
+
+	// Call function(block) for every block in [0, block_count), in
+	// parallel where the standard library has the parallel algorithms.
+	// blocks holds the block numbers, the caller keeps it so it stops
+	// allocating once it is big enough.
+	template <typename Function>
+	void ForEachBlock(
+		const size_t block_count,
+		std::vector<size_t>& blocks,
+		Function function)
+	{
+		blocks.resize(block_count);
+		std::iota(blocks.begin(), blocks.end(), static_cast<size_t>(0));
+		std::for_each(
+#if defined(_WIN32) | defined(_WIN64)
+			std::execution::par,
+#endif
+			blocks.begin(),
+			blocks.end(),
+			function);
+	}
+
+} // end namespace VectorMath.
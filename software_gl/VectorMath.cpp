@@ -448,8 +448,44 @@ namespace VectorMath {
 
 		return *(float*)&det;
 #else
-		// TODO
-		return 0.0f;
+		// Cofactors of the first two rows and of the last two rows taken
+		// as 2x2 determinants (Laplace expansion).
+		const float s0 = _11 * _22 - _21 * _12;
+		const float s1 = _11 * _23 - _21 * _13;
+		const float s2 = _11 * _24 - _21 * _14;
+		const float s3 = _12 * _23 - _22 * _13;
+		const float s4 = _12 * _24 - _22 * _14;
+		const float s5 = _13 * _24 - _23 * _14;
+		const float c5 = _33 * _44 - _43 * _34;
+		const float c4 = _32 * _44 - _42 * _34;
+		const float c3 = _32 * _43 - _42 * _33;
+		const float c2 = _31 * _44 - _41 * _34;
+		const float c1 = _31 * _43 - _41 * _33;
+		const float c0 = _31 * _42 - _41 * _32;
+		const float det =
+			s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+		// Singular, keep the matrix.
+		if (det == 0.0f) return det;
+		const float rd = 1.0f / det;
+		matrix m;
+		m._11 = ( _22 * c5 - _23 * c4 + _24 * c3) * rd;
+		m._12 = (-_12 * c5 + _13 * c4 - _14 * c3) * rd;
+		m._13 = ( _42 * s5 - _43 * s4 + _44 * s3) * rd;
+		m._14 = (-_32 * s5 + _33 * s4 - _34 * s3) * rd;
+		m._21 = (-_21 * c5 + _23 * c2 - _24 * c1) * rd;
+		m._22 = ( _11 * c5 - _13 * c2 + _14 * c1) * rd;
+		m._23 = (-_41 * s5 + _43 * s2 - _44 * s1) * rd;
+		m._24 = ( _31 * s5 - _33 * s2 + _34 * s1) * rd;
+		m._31 = ( _21 * c4 - _22 * c2 + _24 * c0) * rd;
+		m._32 = (-_11 * c4 + _12 * c2 - _14 * c0) * rd;
+		m._33 = ( _41 * s4 - _42 * s2 + _44 * s0) * rd;
+		m._34 = (-_31 * s4 + _32 * s2 - _34 * s0) * rd;
+		m._41 = (-_21 * c3 + _22 * c1 - _23 * c0) * rd;
+		m._42 = ( _11 * c3 - _12 * c1 + _13 * c0) * rd;
+		m._43 = (-_41 * s3 + _42 * s1 - _43 * s0) * rd;
+		m._44 = ( _31 * s3 - _32 * s1 + _33 * s0) * rd;
+		*this = m;
+		return det;
 #endif // ENABLE_VEC
 	}
 
@@ -574,6 +574,21 @@ namespace VectorMath {
 		return result;
 	}
 
+	// Clip space to the screen, x, y and z go from [-1, 1] to [0, width],
+	// [0, height] and [0, 1]. It comes before the divide by w so it can be
+	// concatenated with the other transformations.
+	inline matrix Viewport(const float width, const float height)
+	{
+		matrix result;
+		result(0, 0) = .5f * width;
+		result(1, 1) = .5f * height;
+		result(2, 2) = .5f;
+		result(3, 0) = .5f * width;
+		result(3, 1) = .5f * height;
+		result(3, 2) = .5f;
+		return result;
+	}
+
 #ifdef ENABLE_VEC
 	// Some useful macros:
 
@@ -1035,10 +1050,16 @@ namespace VectorMath {
 		result += (F32vec4)_mm_shuffle_ps(Vec,Vec,0xFF) * Mat._L4;
 		res = result;
 #else 
-		res.x = Vec * vector(Mat._L1);
-		res.y = Vec * vector(Mat._L2);
-		res.z = Vec * vector(Mat._L3);
-		res.w = Vec * vector(Mat._L4);
+		// Copy first, res may alias Vec.
+		const vector v = Vec;
+		res.x = v.x * Mat._11 + v.y * Mat._21 + 
+				  v.z * Mat._31 + v.w * Mat._41;
+		res.y = v.x * Mat._12 + v.y * Mat._22 + 
+				  v.z * Mat._32 + v.w * Mat._42;
+		res.z = v.x * Mat._13 + v.y * Mat._23 + 
+				  v.z * Mat._33 + v.w * Mat._43;
+		res.w = v.x * Mat._14 + v.y * Mat._24 + 
+				  v.z * Mat._34 + v.w * Mat._44;
 #endif // ENABLE_VEC
 	}
 
@@ -1057,10 +1078,7 @@ namespace VectorMath {
 		return (vector)result;
 #else
 		vector res;
-		res.x = Vec * vector(Mat._L1);
-		res.y = Vec * vector(Mat._L2);
-		res.z = Vec * vector(Mat._L3);
-		res.w = Vec * vector(Mat._L4);
+		VectorMult(Vec, Mat, res);
 		return res;
 #endif // ENABLE_VEC
 	}
@@ -1425,16 +1443,15 @@ namespace VectorMath {
 		result += F32vec4(_mm_shuffle_ps(Vec,Vec,0xAA)) * Mat._L3;
 		res = result;
 #else 
-		vector v;
-		v.vec = Vec.vec;
-		res.x = v.x * Mat._11 + v.y * Mat._12 + 
-				  v.z * Mat._13 + v.w * Mat._14;
-		res.y = v.x * Mat._21 + v.y * Mat._22 + 
-				  v.z * Mat._23 + v.w * Mat._24;
-		res.z = v.x * Mat._31 + v.y * Mat._32 + 
-				  v.z * Mat._33 + v.w * Mat._34;
-		res.w = v.x * Mat._41 + v.y * Mat._42 + 
-				  v.z * Mat._43 + v.w * Mat._44;
+		const vector3 v = Vec;
+		res.x = v.x * Mat._11 + v.y * Mat._21 + 
+				  v.z * Mat._31 + Mat._41;
+		res.y = v.x * Mat._12 + v.y * Mat._22 + 
+				  v.z * Mat._32 + Mat._42;
+		res.z = v.x * Mat._13 + v.y * Mat._23 + 
+				  v.z * Mat._33 + Mat._43;
+		res.w = v.x * Mat._14 + v.y * Mat._24 + 
+				  v.z * Mat._34 + Mat._44;
 #endif // ENABLE_VEC
 	}
 
@@ -1450,12 +1467,12 @@ namespace VectorMath {
 		W = F32vec1(1.0f)/W;
 		res = result * _mm_shuffle_ps(W, W, 0x00);
 #else
-		res.x = Vec.x * Mat._11 + Vec.y * Mat._12 + 
-				  Vec.z * Mat._13 + 1.0f * Mat._14;
-		res.y = Vec.x * Mat._21 + Vec.y * Mat._22 + 
-				  Vec.z * Mat._23 + 1.0f * Mat._24;
-		res.z = Vec.x * Mat._31 + Vec.y * Mat._32 + 
-				  Vec.z * Mat._33 + 1.0f * Mat._34;
+		vector v;
+		VectorMult(Vec, Mat, v);
+		const float w = 1.0f / v.w;
+		res.x = v.x * w;
+		res.y = v.y * w;
+		res.z = v.z * w;
 #endif // ENABLE_VEC
 	}
 
@@ -1473,12 +1490,7 @@ namespace VectorMath {
 		return (vector)result;
 #else
 		vector res;
-		res.x = Vec.x * Mat._11 + Vec.y * Mat._12 + 
-				  Vec.z * Mat._13 + 1.0f * Mat._14;
-		res.y = Vec.x * Mat._21 + Vec.y * Mat._22 + 
-				  Vec.z * Mat._23 + 1.0f * Mat._24;
-		res.z = Vec.x * Mat._31 + Vec.y * Mat._32 + 
-				  Vec.z * Mat._33 + 1.0f * Mat._34;
+		VectorMult(Vec, Mat, res);
 		return res;
 #endif // ENABLE_VEC
 	}
@@ -0,0 +1,181 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <vector>
+#include <assert.h>
+#include "Vertex.h"
+
+namespace SoftwareGL {
+
+	enum class VertexCacheMode
+	{
+		// One entry per welded vertex of the mesh (see Mesh::ComputeFlat),
+		// every vertex is shaded once per draw at most. Without welded
+		// vertices the corners go through the FIFO instead.
+		INDEXED,
+		// Small cache of the last corners shaded, the oldest entry is
+		// replaced, as the post-transform cache of a GPU does for an index
+		// buffer streamed without its vertex count.
+		FIFO,
+		// Same, the least recently used entry is replaced.
+		LRU,
+	};
+
+	// A vertex after the vertex shader: its position (in pixels) for the
+	// setup of the triangle and its varyings.
+	template <typename Varyings>
+	struct ShadedVertex
+	{
+		Vertex vertex;
+		Varyings varyings;
+	};
+
+	// Output of the vertex shader kept for the triangles that share a
+	// vertex, so a vertex costs one call instead of one per corner (about 6
+	// on a regular mesh). The buffers are kept from one draw to the next.
+	template <typename Varyings>
+	class VertexCache
+	{
+	public:
+		using Output = ShadedVertex<Varyings>;
+		// Corner of the mesh: index of position, texture and normal.
+		using Key = std::array<int, 3>;
+
+	public:
+		explicit VertexCache(
+			const VertexCacheMode mode = VertexCacheMode::INDEXED,
+			const size_t size = 32) :
+			mode_(mode),
+			entries_(std::max<size_t>(size, 1)) {}
+
+	public:
+		VertexCacheMode GetMode() const { return mode_; }
+		// Forget what was shaded, before each draw. vertex_count is the
+		// number of welded vertices of the draw (INDEXED mode).
+		void Begin(const size_t vertex_count);
+		// Welded vertex, shade() is called the first time it is fetched.
+		template <typename Shade>
+		const Output& Fetch(const size_t vertex, Shade shade);
+		// Corner of a streamed index buffer, shade() is called when it is
+		// not in the cache. The reference is only valid until the next
+		// fetch, which can replace the entry.
+		template <typename Shade>
+		const Output& Fetch(const Key& key, Shade shade);
+		// Counters since the creation of the cache or ResetCounters, shaded
+		// over fetched is the part of corners that missed.
+		size_t GetShadedCount() const { return shaded_count_; }
+		size_t GetFetchCount() const { return fetch_count_; }
+		void ResetCounters()
+		{
+			shaded_count_ = 0;
+			fetch_count_ = 0;
+		}
+
+	private:
+		struct Entry
+		{
+			Key key = {};
+			// Draw the entry was filled in, it is empty for the others.
+			std::uint32_t draw = 0;
+			std::uint64_t last_use = 0;
+			Output output;
+		};
+
+	private:
+		VertexCacheMode mode_;
+		// Stamp of the current draw, 0 is never used.
+		std::uint32_t draw_ = 0;
+		std::uint64_t clock_ = 0;
+		size_t next_entry_ = 0;
+		size_t shaded_count_ = 0;
+		size_t fetch_count_ = 0;
+		// INDEXED, output and draw stamp by welded vertex.
+		std::vector<Output> outputs_ = {};
+		std::vector<std::uint32_t> stamps_ = {};
+		// FIFO and LRU.
+		std::vector<Entry> entries_;
+	};
+
+	template <typename Varyings>
+	void VertexCache<Varyings>::Begin(const size_t vertex_count)
+	{
+		if (++draw_ == 0)
+		{
+			// Wrapped, the old stamps could match again.
+			std::fill(stamps_.begin(), stamps_.end(), 0);
+			for (Entry& entry : entries_) entry.draw = 0;
+			draw_ = 1;
+		}
+		next_entry_ = 0;
+		if (mode_ != VertexCacheMode::INDEXED) return;
+		// Only grows, no allocation once the largest mesh is seen.
+		if (outputs_.size() < vertex_count)
+		{
+			outputs_.resize(vertex_count);
+			stamps_.resize(vertex_count, 0);
+		}
+	}
+
+	template <typename Varyings>
+	template <typename Shade>
+	const typename VertexCache<Varyings>::Output&
+		VertexCache<Varyings>::Fetch(const size_t vertex, Shade shade)
+	{
+		assert(mode_ == VertexCacheMode::INDEXED);
+		assert(vertex < outputs_.size());
+		++fetch_count_;
+		if (stamps_[vertex] != draw_)
+		{
+			outputs_[vertex] = shade();
+			stamps_[vertex] = draw_;
+			++shaded_count_;
+		}
+		return outputs_[vertex];
+	}
+
+	template <typename Varyings>
+	template <typename Shade>
+	const typename VertexCache<Varyings>::Output&
+		VertexCache<Varyings>::Fetch(const Key& key, Shade shade)
+	{
+		++fetch_count_;
+		++clock_;
+		// Small enough for a linear search, as the hardware does.
+		for (Entry& entry : entries_)
+		{
+			if (entry.draw == draw_ && entry.key == key)
+			{
+				entry.last_use = clock_;
+				return entry.output;
+			}
+		}
+		Entry* victim = nullptr;
+		if (mode_ == VertexCacheMode::LRU)
+		{
+			// Empty entries are the oldest.
+			victim = &*std::min_element(
+				entries_.begin(),
+				entries_.end(),
+				[this](const Entry& a, const Entry& b)
+			{
+				const std::uint64_t age_a = a.draw == draw_ ? a.last_use : 0;
+				const std::uint64_t age_b = b.draw == draw_ ? b.last_use : 0;
+				return age_a < age_b;
+			});
+		}
+		else
+		{
+			victim = &entries_[next_entry_];
+			next_entry_ = (next_entry_ + 1) % entries_.size();
+		}
+		victim->key = key;
+		victim->draw = draw_;
+		victim->last_use = clock_;
+		victim->output = shade();
+		++shaded_count_;
+		return victim->output;
+	}
+
+}	// End namespace SoftwareGL.
@@ -0,0 +1,232 @@
+#include "VertexProcessor.h"
+
+#include <algorithm>
+#include "VectorBatch.h"
+
+namespace SoftwareGL {
+
+	namespace {
+
+		// Normals are loaded with a w of 1, they go through the inverse
+		// transpose of the upper 3x3 of the model (an affine one) so they
+		// stay perpendicular to the surface under a non uniform scale, and
+		// not through its translation. They are not normalized.
+		VectorMath::matrix GetNormalMatrix(const VectorMath::matrix& model)
+		{
+			VectorMath::matrix normal_matrix = model;
+			normal_matrix._41 = 0.f;
+			normal_matrix._42 = 0.f;
+			normal_matrix._43 = 0.f;
+			normal_matrix.Inverse();
+			normal_matrix.Transpose();
+			return normal_matrix;
+		}
+
+	}	// End anonymous namespace.
+
+	void VertexProcessor::Process(
+		const Mesh& mesh,
+		const VectorMath::matrix& model,
+		const VectorMath::matrix& view,
+		const VectorMath::matrix& projection,
+		const float width,
+		const float height)
+	{
+		SetMesh(mesh);
+		const Instance instance = { model };
+		ProcessInstances(
+			&instance,
+			1,
+			view * projection * VectorMath::Viewport(width, height));
+	}
+
+	void VertexProcessor::SetMesh(const Mesh& mesh)
+	{
+		source_positions_ = mesh.GetPositions();
+		source_normals_ = mesh.GetNormals();
+		textures_ = mesh.GetTextures();
+		indices_ = mesh.GetIndices();
+		clusters_ = mesh.GetClusters();
+		colors_.clear();
+		// The welded vertices are only usable while they follow the
+		// triangles.
+		const std::vector<unsigned int>& flat_indices = mesh.GetFlatIndices();
+		const bool has_flat =
+			!flat_indices.empty() &&
+			flat_indices.size() == mesh.GetIndices().size();
+		vertex_indices_ =
+			has_flat ?
+			BufferView<unsigned int>(flat_indices) :
+			BufferView<unsigned int>();
+		vertex_count_ = has_flat ? mesh.GetFlatPositions().size() / 3 : 0;
+	}
+
+	void VertexProcessor::ProcessInstances(
+		const Instance* instances,
+		const size_t count,
+		const VectorMath::matrix& view_projection)
+	{
+		const size_t position_count = source_positions_.size();
+		const size_t normal_count = source_normals_.size();
+		position_stride_ = position_count;
+		normal_stride_ = normal_count;
+		// Keeps the capacity, no allocation once the buffers are as big as
+		// the largest batch.
+		positions_.resize(position_count * count);
+		normals_.resize(normal_count * count);
+		colors_.resize(count);
+		position_matrices_.resize(count);
+		normal_matrices_.resize(count);
+		// Matrices once per instance, not per block.
+		for (size_t i = 0; i < count; ++i)
+		{
+			colors_[i] = instances[i].color;
+			position_matrices_[i] = instances[i].model * view_projection;
+			normal_matrices_[i] = GetNormalMatrix(instances[i].model);
+		}
+		// Positions and normals of a block go through both kernels one
+		// after the other, the blocks of every instance are spread over
+		// the threads.
+		constexpr size_t block_size = VectorMath::batch_block_size;
+		const size_t block_per_instance =
+			(std::max(position_count, normal_count) + block_size - 1) /
+			block_size;
+		VectorMath::ForEachBlock(
+			block_per_instance * count,
+			blocks_,
+			[&](const size_t block)
+		{
+			const size_t instance_index = block / block_per_instance;
+			const size_t first = (block % block_per_instance) * block_size;
+			if (first < position_count)
+			{
+				VectorMath::VectorMultDivideBatch(
+					&source_positions_[first],
+					position_matrices_[instance_index],
+					&positions_[instance_index * position_count + first],
+					std::min(block_size, position_count - first));
+			}
+			if (first < normal_count)
+			{
+				VectorMath::VectorMultBatch(
+					&source_normals_[first],
+					normal_matrices_[instance_index],
+					&normals_[instance_index * normal_count + first],
+					std::min(block_size, normal_count - first));
+			}
+		});
+	}
+
+	void VertexProcessor::Process(
+		const QuantizedMesh& mesh,
+		const VectorMath::matrix& model,
+		const VectorMath::matrix& view,
+		const VectorMath::matrix& projection,
+		const float width,
+		const float height)
+	{
+		const std::vector<QuantizedMesh::Position>& positions =
+			mesh.GetPositions();
+		const size_t normal_count = mesh.GetNormalCount();
+		positions_.resize(positions.size());
+		normals_.resize(normal_count);
+		mesh.DecodeTextures(decoded_textures_);
+		textures_ = decoded_textures_;
+		indices_ = mesh.GetIndices();
+		clusters_ = mesh.GetClusters();
+		vertex_indices_ = {};
+		vertex_count_ = 0;
+		source_positions_ = {};
+		source_normals_ = {};
+		colors_.assign(1, Instance().color);
+		position_stride_ = positions_.size();
+		normal_stride_ = normals_.size();
+		// The positions are decoded by the first matrix of the chain.
+		const VectorMath::matrix position_matrix =
+			mesh.GetPositionMatrix() * model * view * projection *
+			VectorMath::Viewport(width, height);
+		const VectorMath::matrix normal_matrix = GetNormalMatrix(model);
+		// Decoded a block at a time on the stack, transformed while it is
+		// still in cache, positions and normals of a block together.
+		constexpr size_t block_size = VectorMath::batch_block_size;
+		const size_t vertex_count = std::max(positions.size(), normal_count);
+		VectorMath::ForEachBlock(
+			(vertex_count + block_size - 1) / block_size,
+			blocks_,
+			[&](const size_t block)
+		{
+			const size_t first = block * block_size;
+			std::array<VectorMath::vector4, block_size> decoded;
+			if (first < positions.size())
+			{
+				const size_t count =
+					std::min(block_size, positions.size() - first);
+				for (size_t i = 0; i < count; ++i)
+				{
+					const QuantizedMesh::Position& q = positions[first + i];
+					decoded[i] = VectorMath::vector4(q[0], q[1], q[2], 1.f);
+				}
+				VectorMath::VectorMultDivideBatch(
+					decoded.data(),
+					position_matrix,
+					&positions_[first],
+					count);
+			}
+			if (first < normal_count)
+			{
+				const size_t count = std::min(block_size, normal_count - first);
+				for (size_t i = 0; i < count; ++i)
+				{
+					decoded[i] = mesh.GetNormal(first + i);
+				}
+				VectorMath::VectorMultBatch(
+					decoded.data(),
+					normal_matrix,
+					&normals_[first],
+					count);
+			}
+		});
+	}
+
+	std::array<int, 3> VertexProcessor::GetVertexKey(const size_t corner) const
+	{
+		const std::array<int, 3>* corners = &indices_[corner - corner % 3];
+		std::array<int, 3> key = indices_[corner];
+		if (corners[0][1] == -1 || corners[1][1] == -1 || corners[2][1] == -1)
+		{
+			key[1] = -1;
+		}
+		if (corners[0][2] == -1 || corners[1][2] == -1 || corners[2][2] == -1)
+		{
+			key[2] = -1;
+		}
+		return key;
+	}
+
+	Vertex VertexProcessor::GetVertex(
+		const size_t corner,
+		const size_t instance /*= 0*/) const
+	{
+		const std::array<int, 3> key = GetVertexKey(corner);
+		Vertex v;
+		v.SetPosition(positions_[instance * position_stride_ + key[0]]);
+		v.SetColor(colors_[instance]);
+		if (key[1] != -1) v.SetTexture(textures_[key[1]]);
+		if (key[2] != -1)
+		{
+			v.SetNormal(normals_[instance * normal_stride_ + key[2]]);
+		}
+		return v;
+	}
+
+	Triangle VertexProcessor::GetTriangle(
+		const size_t triangle,
+		const size_t instance /*= 0*/) const
+	{
+		return Triangle(
+			GetVertex(triangle * 3, instance),
+			GetVertex(triangle * 3 + 1, instance),
+			GetVertex(triangle * 3 + 2, instance));
+	}
+
+}	// End namespace SoftwareGL.
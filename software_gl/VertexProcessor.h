@@ -0,0 +1,122 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include "BufferView.h"
+#include "Mesh.h"
+#include "MeshCluster.h"
+#include "QuantizedMesh.h"
+#include "Triangle.h"
+#include "VectorMath.h"
+
+namespace SoftwareGL {
+
+	// Copy of a mesh in an instanced draw (see Renderer::DrawInstanced).
+	struct Instance
+	{
+		// Model to world.
+		VectorMath::matrix model = {};
+		// Color of every vertex, the default one of Vertex.
+		VectorMath::vector color = { .5f, .5f, .5f, 1.f };
+	};
+
+	// Vertex stage, reads a mesh that it never modifies and writes its
+	// vertices transformed to the screen into buffers that are kept from
+	// one call to the next (they only grow), so drawing the same meshes
+	// every frame doesn't allocate. Indices, texture coordinates and
+	// clusters are read from the source, which has to outlive the draw.
+	class VertexProcessor
+	{
+	public:
+		// Positions go through model, view and projection then to pixels
+		// of a width x height screen, normals only through model.
+		void Process(
+			const Mesh& mesh,
+			const VectorMath::matrix& model,
+			const VectorMath::matrix& view,
+			const VectorMath::matrix& projection,
+			const float width,
+			const float height);
+		// Compact meshes are decoded into the buffers first.
+		void Process(
+			const QuantizedMesh& mesh,
+			const VectorMath::matrix& model,
+			const VectorMath::matrix& view,
+			const VectorMath::matrix& projection,
+			const float width,
+			const float height);
+		// Instanced meshes are set once and their instances are processed
+		// by batches, one after the other in the buffers. view_projection
+		// goes to the screen (see VectorMath::Viewport).
+		void SetMesh(const Mesh& mesh);
+		void ProcessInstances(
+			const Instance* instances,
+			const size_t count,
+			const VectorMath::matrix& view_projection);
+
+	public:
+		size_t GetTriangleCount() const { return indices_.size() / 3; }
+		// Instances in the buffers, 1 after Process.
+		size_t GetInstanceCount() const { return colors_.size(); }
+		// Assemble a triangle of the last processed mesh (on the stack),
+		// as Mesh::IndexedTriangle::ToTriangle does.
+		Triangle GetTriangle(
+			const size_t triangle,
+			const size_t instance = 0) const;
+		// Corner (in GetIndices) of the last processed mesh alone, for the
+		// vertex cache. Same as in GetTriangle, the texture and the normal
+		// are only set when the 3 corners of its triangle have one.
+		Vertex GetVertex(
+			const size_t corner,
+			const size_t instance = 0) const;
+		// Indices the vertex of a corner is made of, the texture and the
+		// normal GetVertex leaves out are -1.
+		std::array<int, 3> GetVertexKey(const size_t corner) const;
+		// Position, texture and normal index of every corner.
+		BufferView<std::array<int, 3>> GetIndices() const { return indices_; }
+		// Welded vertex of every corner (see Mesh::ComputeFlat), empty if
+		// the source has none.
+		BufferView<unsigned int> GetVertexIndices() const
+		{
+			return vertex_indices_;
+		}
+		size_t GetVertexCount() const { return vertex_count_; }
+		// Model space bounds of the source (see Mesh::BuildClusters).
+		BufferView<MeshCluster> GetClusters() const { return clusters_; }
+		const std::vector<VectorMath::vector4>& GetPositions() const
+		{
+			return positions_;
+		}
+		const std::vector<VectorMath::vector4>& GetNormals() const
+		{
+			return normals_;
+		}
+
+	private:
+		// Owned, reused for every mesh.
+		std::vector<VectorMath::vector4> positions_ = {};
+		std::vector<VectorMath::vector4> normals_ = {};
+		std::vector<VectorMath::vector3> decoded_textures_ = {};
+		std::vector<VectorMath::vector> colors_ = {};
+		// Position (model to screen) and normal matrices of every instance
+		// of the batch.
+		std::vector<VectorMath::matrix> position_matrices_ = {};
+		std::vector<VectorMath::matrix> normal_matrices_ = {};
+		// Block numbers of the parallel loops (see VectorMath::ForEachBlock).
+		std::vector<size_t> blocks_ = {};
+		// Positions and normals of one instance.
+		size_t position_stride_ = 0;
+		size_t normal_stride_ = 0;
+
+	private:
+		// Borrowed from the source (or decoded_textures_).
+		BufferView<VectorMath::vector4> source_positions_ = {};
+		BufferView<VectorMath::vector4> source_normals_ = {};
+		BufferView<VectorMath::vector3> textures_ = {};
+		BufferView<std::array<int, 3>> indices_ = {};
+		BufferView<MeshCluster> clusters_ = {};
+		BufferView<unsigned int> vertex_indices_ = {};
+		size_t vertex_count_ = 0;
+	};
+
+}	// End namespace SoftwareGL.
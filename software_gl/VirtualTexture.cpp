@@ -0,0 +1,313 @@
+#include "VirtualTexture.h"
+
+#include <algorithm>
+#include <limits>
+#include <assert.h>
+
+namespace SoftwareGL {
+
+	namespace {
+
+		constexpr size_t tga_header_size = 18;
+
+		size_t ReadUInt16(const std::uint8_t* data)
+		{
+			return static_cast<size_t>(data[0] | (data[1] << 8));
+		}
+
+	}	// End anonymous namespace.
+
+	VirtualTexture::VirtualTexture(
+		const size_t page_size /*= 128*/,
+		const size_t memory_budget /*= 64 * 1024 * 1024*/) :
+		page_size_(page_size),
+		memory_budget_(memory_budget)
+	{
+		assert(page_size_ > 0);
+		const size_t page_bytes =
+			page_size_ * page_size_ * sizeof(VectorMath::vector);
+		max_pages_ = std::max<size_t>(1, memory_budget_ / page_bytes);
+	}
+
+	VirtualTexture::~VirtualTexture()
+	{
+		StopLoader();
+	}
+
+	bool VirtualTexture::Open(const std::string& path)
+	{
+		StopLoader();
+		levels_.clear();
+		slots_.clear();
+		wanted_.clear();
+		queue_.clear();
+		loaded_.clear();
+		if (!file_.Open(path)) return false;
+		const std::uint8_t* data = file_.GetData();
+		if (file_.GetSize() < tga_header_size) return false;
+		// Raw true color (2) or grayscale (3) only, RLE can't be paged.
+		const std::uint8_t image_type = data[2];
+		const size_t bits = data[16];
+		if (image_type != 2 && image_type != 3) return false;
+		if (bits != 8 && bits != 24 && bits != 32) return false;
+		if ((image_type == 3) != (bits == 8)) return false;
+		bytes_per_pixel_ = bits / 8;
+		dx_ = ReadUInt16(data + 12);
+		dy_ = ReadUInt16(data + 14);
+		top_origin_ = (data[17] & 0x20) != 0;
+		right_origin_ = (data[17] & 0x10) != 0;
+		size_t offset = tga_header_size + data[0];
+		if (data[1] == 1)
+		{
+			offset += ReadUInt16(data + 5) * ((data[7] + 7) / 8);
+		}
+		if (dx_ == 0 || dy_ == 0) return false;
+		if (offset + dx_ * dy_ * bytes_per_pixel_ > file_.GetSize())
+		{
+			return false;
+		}
+		pixels_ = data + offset;
+
+		// Levels down to the tail, the first one that fits in a page.
+		for (size_t level = 0;; ++level)
+		{
+			Level l;
+			l.dx = std::max<size_t>(1, dx_ >> level);
+			l.dy = std::max<size_t>(1, dy_ >> level);
+			l.pages_x = (l.dx + page_size_ - 1) / page_size_;
+			l.pages_y = (l.dy + page_size_ - 1) / page_size_;
+			l.page_table.assign(l.pages_x * l.pages_y, -1);
+			l.requested.assign(l.pages_x * l.pages_y, 0);
+			levels_.push_back(std::move(l));
+			if (levels_.back().pages_x == 1 && levels_.back().pages_y == 1)
+			{
+				break;
+			}
+		}
+		tail_level_ = levels_.size() - 1;
+		const Level& tail = levels_[tail_level_];
+		tail_ = Image(tail.dx, tail.dy);
+		for (size_t y = 0; y < tail.dy; ++y)
+		{
+			for (size_t x = 0; x < tail.dx; ++x)
+			{
+				tail_[x + y * tail.dx] = FetchLevel(tail_level_, x, y);
+			}
+		}
+		stop_ = false;
+		loader_ = std::thread(&VirtualTexture::LoaderThread, this);
+		return true;
+	}
+
+	void VirtualTexture::Update()
+	{
+		++frame_;
+		std::vector<LoadedPage> loaded;
+		std::vector<std::uint64_t> dropped;
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			std::swap(loaded, loaded_);
+			// Newest requests are served first, forget the oldest ones when
+			// the loader falls behind.
+			for (const std::uint64_t key : wanted_) queue_.push_back(key);
+			while (queue_.size() > max_pages_)
+			{
+				dropped.push_back(queue_.front());
+				queue_.pop_front();
+			}
+		}
+		if (!wanted_.empty()) condition_.notify_one();
+		wanted_.clear();
+		for (const std::uint64_t key : dropped)
+		{
+			Level& level = levels_[key >> 48];
+			level.requested[
+				((key >> 24) & 0xffffff) * level.pages_x +
+				(key & 0xffffff)] = 0;
+		}
+		for (LoadedPage& page : loaded) Install(page);
+	}
+
+	VectorMath::vector VirtualTexture::Sample(
+		const float u,
+		const float v,
+		const float lod)
+	{
+		// Not opened (or failed to), white leaves the shading as it is.
+		if (levels_.empty()) return { 1.f, 1.f, 1.f, 1.f };
+		const size_t wanted = std::min(
+			static_cast<size_t>(std::max(lod, 0.f)),
+			tail_level_);
+		for (size_t level = wanted; level < tail_level_; ++level)
+		{
+			Level& l = levels_[level];
+			const size_t x = std::clamp<int>(
+				static_cast<int>(u * l.dx), 0, static_cast<int>(l.dx) - 1);
+			const size_t y = std::clamp<int>(
+				static_cast<int>(v * l.dy), 0, static_cast<int>(l.dy) - 1);
+			const size_t px = x / page_size_;
+			const size_t py = y / page_size_;
+			const int slot = l.page_table[px + py * l.pages_x];
+			if (slot >= 0)
+			{
+				Slot& s = slots_[slot];
+				s.last_used = frame_;
+				return s.texels[
+					(x % page_size_) + (y % page_size_) * page_size_];
+			}
+			// Only ask for the level we want, coarser ones are fallbacks.
+			if (level == wanted) Request(level, px, py);
+		}
+		const Level& tail = levels_[tail_level_];
+		const size_t x = std::clamp<int>(
+			static_cast<int>(u * tail.dx), 0, static_cast<int>(tail.dx) - 1);
+		const size_t y = std::clamp<int>(
+			static_cast<int>(v * tail.dy), 0, static_cast<int>(tail.dy) - 1);
+		return tail_[x + y * tail.dx];
+	}
+
+	std::uint64_t VirtualTexture::MakeKey(size_t level, size_t px, size_t py)
+	{
+		return
+			(static_cast<std::uint64_t>(level) << 48) |
+			(static_cast<std::uint64_t>(py) << 24) |
+			static_cast<std::uint64_t>(px);
+	}
+
+	VectorMath::vector VirtualTexture::FetchSource(size_t x, size_t y) const
+	{
+		const size_t row = top_origin_ ? dy_ - 1 - y : y;
+		const size_t column = right_origin_ ? dx_ - 1 - x : x;
+		const std::uint8_t* p =
+			pixels_ + (row * dx_ + column) * bytes_per_pixel_;
+		switch (bytes_per_pixel_)
+		{
+		case 1:
+		{
+			const float l = p[0] / 255.f;
+			return VectorMath::vector(l, l, l, 1.f);
+		}
+		case 3:
+			return VectorMath::vector(
+				p[2] / 255.f, p[1] / 255.f, p[0] / 255.f, 1.f);
+		default:
+			return VectorMath::vector(
+				p[2] / 255.f, p[1] / 255.f, p[0] / 255.f, p[3] / 255.f);
+		}
+	}
+
+	VectorMath::vector VirtualTexture::FetchLevel(
+		size_t level,
+		size_t x,
+		size_t y) const
+	{
+		if (level == 0) return FetchSource(x, y);
+		const size_t footprint = size_t(1) << level;
+		const size_t x0 = std::min(x * footprint + footprint / 4, dx_ - 1);
+		const size_t x1 = std::min(x0 + footprint / 2, dx_ - 1);
+		const size_t y0 = std::min(y * footprint + footprint / 4, dy_ - 1);
+		const size_t y1 = std::min(y0 + footprint / 2, dy_ - 1);
+		return
+			(FetchSource(x0, y0) +
+				FetchSource(x1, y0) +
+				FetchSource(x0, y1) +
+				FetchSource(x1, y1)) * .25f;
+	}
+
+	void VirtualTexture::LoadPage(
+		std::uint64_t key,
+		std::vector<VectorMath::vector>& texels) const
+	{
+		const size_t level = static_cast<size_t>(key >> 48);
+		const size_t py = static_cast<size_t>((key >> 24) & 0xffffff);
+		const size_t px = static_cast<size_t>(key & 0xffffff);
+		const Level& l = levels_[level];
+		texels.resize(page_size_ * page_size_);
+		for (size_t y = 0; y < page_size_; ++y)
+		{
+			const size_t ly = std::min(py * page_size_ + y, l.dy - 1);
+			for (size_t x = 0; x < page_size_; ++x)
+			{
+				const size_t lx = std::min(px * page_size_ + x, l.dx - 1);
+				texels[x + y * page_size_] = FetchLevel(level, lx, ly);
+			}
+		}
+	}
+
+	void VirtualTexture::Install(LoadedPage& page)
+	{
+		int slot = static_cast<int>(slots_.size());
+		if (slots_.size() < max_pages_)
+		{
+			slots_.push_back({});
+		}
+		else
+		{
+			// Evict the least recently used page.
+			auto it = std::min_element(
+				slots_.begin(),
+				slots_.end(),
+				[](const Slot& a, const Slot& b)
+			{
+				return a.last_used < b.last_used;
+			});
+			slot = static_cast<int>(std::distance(slots_.begin(), it));
+			const std::uint64_t old = it->key;
+			Level& level = levels_[old >> 48];
+			const size_t index =
+				((old >> 24) & 0xffffff) * level.pages_x + (old & 0xffffff);
+			level.page_table[index] = -1;
+			level.requested[index] = 0;
+		}
+		Slot& s = slots_[slot];
+		s.key = page.key;
+		s.last_used = frame_;
+		s.texels = std::move(page.texels);
+		Level& level = levels_[page.key >> 48];
+		level.page_table[
+			((page.key >> 24) & 0xffffff) * level.pages_x +
+			(page.key & 0xffffff)] = slot;
+	}
+
+	void VirtualTexture::Request(size_t level, size_t px, size_t py)
+	{
+		Level& l = levels_[level];
+		std::uint8_t& requested = l.requested[px + py * l.pages_x];
+		if (requested) return;
+		requested = 1;
+		wanted_.push_back(MakeKey(level, px, py));
+	}
+
+	void VirtualTexture::LoaderThread()
+	{
+		while (true)
+		{
+			std::uint64_t key = 0;
+			{
+				std::unique_lock<std::mutex> lock(mutex_);
+				condition_.wait(lock, [this]
+				{
+					return stop_ || !queue_.empty();
+				});
+				if (stop_) return;
+				key = queue_.back();
+				queue_.pop_back();
+			}
+			LoadedPage page{ key, {} };
+			LoadPage(key, page.texels);
+			std::lock_guard<std::mutex> lock(mutex_);
+			loaded_.push_back(std::move(page));
+		}
+	}
+
+	void VirtualTexture::StopLoader()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			stop_ = true;
+		}
+		condition_.notify_all();
+		if (loader_.joinable()) loader_.join();
+	}
+
+}	// End namespace SoftwareGL.
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Image.h"
+#include "MappedFile.h"
+#include "VectorMath.h"
+
+namespace SoftwareGL {
+
+	// Texture too large to be held as an Image. The source (a raw TGA) stays
+	// mapped and is cut into square pages per mip level, only the pages that
+	// are sampled get decoded into a cache bounded by a memory budget. A
+	// missing page is requested from a background loader and the sample
+	// falls back to the next coarser resident level, down to the mip tail
+	// (the first level that fits in a page) which is always resident.
+	class VirtualTexture
+	{
+	public:
+		VirtualTexture(
+			const size_t page_size = 128,
+			const size_t memory_budget = 64 * 1024 * 1024);
+		VirtualTexture(const VirtualTexture&) = delete;
+		VirtualTexture& operator=(const VirtualTexture&) = delete;
+		virtual ~VirtualTexture();
+
+	public:
+		// Only raw (uncompressed) TGA can be paged from the file.
+		bool Open(const std::string& path);
+		// To be called once per frame from the render thread, install the
+		// loaded pages and send the new requests to the loader.
+		void Update();
+		// Nearest sample at normalized coordinates, lod is the wanted level.
+		// White when the texture isn't open.
+		VectorMath::vector Sample(
+			const float u,
+			const float v,
+			const float lod);
+
+	public:
+		const std::pair<size_t, size_t> GetSize() const
+		{
+			return std::make_pair(dx_, dy_);
+		}
+		float GetWidth() const { return static_cast<float>(dx_); }
+		float GetHeight() const { return static_cast<float>(dy_); }
+		size_t GetLevelCount() const { return levels_.size(); }
+		size_t GetResidentPageCount() const { return slots_.size(); }
+		size_t GetMaxResidentPageCount() const { return max_pages_; }
+
+	protected:
+		struct Level
+		{
+			size_t dx;
+			size_t dy;
+			size_t pages_x;
+			size_t pages_y;
+			// Slot of every page or -1 if not resident.
+			std::vector<int> page_table;
+			// Page already asked for (and not evicted since).
+			std::vector<std::uint8_t> requested;
+		};
+		struct Slot
+		{
+			std::uint64_t key;
+			std::uint64_t last_used;
+			std::vector<VectorMath::vector> texels;
+		};
+		struct LoadedPage
+		{
+			std::uint64_t key;
+			std::vector<VectorMath::vector> texels;
+		};
+		static std::uint64_t MakeKey(size_t level, size_t px, size_t py);
+		// Texel from the source file, y going up as in an Image.
+		VectorMath::vector FetchSource(size_t x, size_t y) const;
+		// Texel at a level, average of 4 source texels spread over its
+		// footprint so that coarse pages cost the same as fine ones.
+		VectorMath::vector FetchLevel(size_t level, size_t x, size_t y) const;
+		void LoadPage(
+			std::uint64_t key,
+			std::vector<VectorMath::vector>& texels) const;
+		void Install(LoadedPage& page);
+		void Request(size_t level, size_t px, size_t py);
+		void LoaderThread();
+		void StopLoader();
+
+	private:
+		// Source.
+		MappedFile file_;
+		const std::uint8_t* pixels_ = nullptr;
+		size_t bytes_per_pixel_ = 0;
+		bool top_origin_ = false;
+		bool right_origin_ = false;
+		size_t dx_ = 0;
+		size_t dy_ = 0;
+		// Pages (render thread only).
+		const size_t page_size_;
+		const size_t memory_budget_;
+		size_t max_pages_ = 0;
+		std::vector<Level> levels_ = {};
+		std::vector<Slot> slots_ = {};
+		std::vector<std::uint64_t> wanted_ = {};
+		Image tail_ = {};
+		size_t tail_level_ = 0;
+		std::uint64_t frame_ = 0;
+		// Loader (shared, guarded by mutex_).
+		std::mutex mutex_;
+		std::condition_variable condition_;
+		std::deque<std::uint64_t> queue_ = {};
+		std::vector<LoadedPage> loaded_ = {};
+		bool stop_ = false;
+		std::thread loader_;
+	};
+
+}	// End namespace SoftwareGL.